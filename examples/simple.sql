@@ -14,15 +14,16 @@ INSERT INTO accounts VALUES (10, "Assets:Investment:GRMN", unicode('S'));
 INSERT INTO account_securities VALUES (10, "GRMN");
 INSERT INTO accounts VALUES (11, "Income:Salary", unicode('I'));
 
--- Transactions
-INSERT INTO transactions VALUES (1, "2025-06-10", "Paycheck", 11, 6);
-INSERT INTO cash_transactions VALUES (1, 1012.56);
+-- Transactions. The views take ISO 8601 dates and store them as Julian days. Amounts are in
+-- cents, and unit prices and quantities are in 1/10000ths of a dollar and of a share
+INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)
+    VALUES ("2025-06-10", "Paycheck", 11, 6, 101256);
 
-INSERT INTO transactions VALUES (2, "2025-06-07", "Purchase Garmin stock", 6, 10);
-INSERT INTO security_transactions VALUES (2, 11.50, 7);
+INSERT INTO security_transactions_view(date, description, source, destination, unit_price, quantity)
+    VALUES ("2025-06-07", "Purchase Garmin stock", 6, 10, 115000, 70000);
 
-INSERT INTO transactions VALUES (3, "2025-06-08", "Purchase Ford stock", 6, 9);
-INSERT INTO security_transactions VALUES (3, 5.078, 19);
+INSERT INTO security_transactions_view(date, description, source, destination, unit_price, quantity)
+    VALUES ("2025-06-08", "Purchase Ford stock", 6, 9, 50780, 190000);
 
-INSERT INTO transactions VALUES (4, "2025-07-01", "Sell Garmin stock", 10, 6);
-INSERT INTO security_transactions VALUES (4, 10.0001, -2);
+INSERT INTO security_transactions_view(date, description, source, destination, unit_price, quantity)
+    VALUES ("2025-07-01", "Sell Garmin stock", 10, 6, 100001, -20000);
@@ -0,0 +1,16 @@
+pragma user_version = 10;
+
+
+-- Transactions brought in from imported statements, keyed by the account whose statement they
+-- came from and their ID in that statement (the FITID, or a hash of the transaction's contents if
+-- it has none), so that importing an overlapping statement again skips the ones already imported
+CREATE TABLE imported_transactions (
+    account_id INTEGER NOT NULL REFERENCES accounts ON DELETE CASCADE,
+    import_key TEXT NOT NULL,
+    transaction_id INTEGER NOT NULL REFERENCES transactions ON DELETE CASCADE,
+    PRIMARY KEY (account_id, import_key)
+) STRICT, WITHOUT ROWID;
+
+
+-- Used when a transaction is deleted
+CREATE INDEX imported_transactions_transaction_id ON imported_transactions(transaction_id);
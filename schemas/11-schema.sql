@@ -0,0 +1,15 @@
+pragma user_version = 11;
+
+
+-- Imported transactions whose description contains a rule's pattern (ignoring case) have the
+-- rule's account as their other side. When several patterns match, the longest one wins, and
+-- then the oldest rule
+CREATE TABLE categorisation_rules (
+    id INTEGER PRIMARY KEY,
+    pattern TEXT UNIQUE NOT NULL CHECK (pattern != ''),
+    account_id INTEGER NOT NULL REFERENCES accounts ON DELETE CASCADE
+) STRICT;
+
+
+-- Used when an account is deleted
+CREATE INDEX categorisation_rules_account_id ON categorisation_rules(account_id);
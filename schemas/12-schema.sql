@@ -0,0 +1,6 @@
+pragma user_version = 12;
+
+
+-- Used to find the other side of a transfer when importing: a leg with a given amount, in a
+-- given account, within a few days of a given date
+CREATE INDEX postings_amount ON postings(account_id, amount, date);
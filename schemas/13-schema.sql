@@ -0,0 +1,6 @@
+pragma user_version = 13;
+
+
+-- Used to list the transactions of a large level of the account hierarchy in date order (see
+-- SubtreeTransactions). The rest of the primary key (account_id) is included implicitly
+CREATE INDEX postings_date ON postings(date, transaction_id, amount);
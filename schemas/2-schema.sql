@@ -0,0 +1,9 @@
+pragma user_version = 2;
+
+
+-- Used by per-account transaction lookups. Each index yields a single account's
+-- transactions in (date, id) order, so each side of a "source = X or destination = X"
+-- query becomes one range scan
+CREATE INDEX transactions_source_date ON transactions(source, date);
+
+CREATE INDEX transactions_destination_date ON transactions(destination, date);
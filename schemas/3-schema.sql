@@ -0,0 +1,147 @@
+pragma user_version = 3;
+
+
+-- Amounts move from REAL dollars to INTEGER counts of fixed fractions (see models/Money.hpp)
+-- so that sums are exact. The views that read these tables are rebuilt afterwards
+DROP VIEW transactions_as_cash_view;
+
+DROP VIEW security_transactions_view;
+
+CREATE TABLE new_cash_transactions (
+    transaction_id INTEGER PRIMARY KEY REFERENCES transactions ON DELETE CASCADE,
+    amount INTEGER NOT NULL -- in cents
+) STRICT;
+
+INSERT INTO new_cash_transactions
+    SELECT transaction_id, CAST(round(amount * 100) AS INTEGER) FROM cash_transactions;
+
+DROP TABLE cash_transactions;
+
+ALTER TABLE new_cash_transactions RENAME TO cash_transactions;
+
+CREATE TABLE new_security_transactions (
+    transaction_id INTEGER PRIMARY KEY REFERENCES transactions ON DELETE CASCADE,
+    unit_price INTEGER NOT NULL, -- in 1/10000ths of a dollar
+    quantity INTEGER NOT NULL -- in 1/10000ths of a share
+) STRICT;
+
+INSERT INTO new_security_transactions
+    SELECT transaction_id, CAST(round(unit_price * 10000) AS INTEGER), CAST(round(quantity * 10000) AS INTEGER)
+    FROM security_transactions;
+
+DROP TABLE security_transactions;
+
+ALTER TABLE new_security_transactions RENAME TO security_transactions;
+
+
+-- Shows all transactions in terms of cash value (in cents). The value of a security
+-- transaction is rounded half away from zero to the nearest cent
+CREATE VIEW transactions_as_cash_view (id, date, description, source, destination, amount) AS
+    SELECT t.id, t.date, t.description, t.source, t.destination,
+           iif(ct.amount IS NULL,
+               (st.unit_price * st.quantity + iif(st.unit_price * st.quantity < 0, -500000, 500000)) / 1000000,
+               ct.amount)
+    FROM transactions t
+    LEFT JOIN cash_transactions ct ON ct.transaction_id = t.id
+    LEFT JOIN security_transactions st ON st.transaction_id = t.id;
+
+CREATE TRIGGER tac_add_row
+INSTEAD OF INSERT ON transactions_as_cash_view
+BEGIN
+    INSERT INTO transactions(date, description, source, destination)
+        VALUES (NEW.date, NEW.description, NEW.source, NEW.destination);
+    INSERT INTO cash_transactions VALUES (last_insert_rowid(), NEW.amount);
+END;
+
+CREATE TRIGGER tac_date_update
+INSTEAD OF UPDATE OF date ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET date = NEW.date WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_description_update
+INSTEAD OF UPDATE OF description ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET description = NEW.description WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_source_update
+INSTEAD OF UPDATE OF source ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET source = NEW.source WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_destination_update
+INSTEAD OF UPDATE OF destination ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET destination = NEW.destination WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_amount_update
+INSTEAD OF UPDATE OF amount ON transactions_as_cash_view
+BEGIN
+    UPDATE cash_transactions SET amount = NEW.amount WHERE transaction_id = NEW.id;
+END;
+
+CREATE TRIGGER tac_delete
+INSTEAD OF DELETE ON transactions_as_cash_view
+BEGIN
+    DELETE FROM transactions WHERE id = OLD.id;
+END;
+
+
+-- Shows all transactions involving securities
+CREATE VIEW security_transactions_view (id, date, description, source, destination, unit_price, quantity) AS
+    SELECT t.id, t.date, t.description, t.source, t.destination, st.unit_price, st.quantity
+    FROM transactions t
+    LEFT JOIN security_transactions st ON st.transaction_id = t.id;
+
+CREATE TRIGGER st_add_row
+INSTEAD OF INSERT ON security_transactions_view
+BEGIN
+    INSERT INTO transactions(date, description, source, destination)
+        VALUES (NEW.date, NEW.description, NEW.source, NEW.destination);
+    INSERT INTO security_transactions VALUES (last_insert_rowid(), NEW.unit_price, NEW.quantity);
+END;
+
+CREATE TRIGGER st_date_update
+INSTEAD OF UPDATE OF date ON security_transactions_view
+BEGIN
+    UPDATE transactions SET date = NEW.date WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_description_update
+INSTEAD OF UPDATE OF description ON security_transactions_view
+BEGIN
+    UPDATE transactions SET description = NEW.description WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_source_update
+INSTEAD OF UPDATE OF source ON security_transactions_view
+BEGIN
+    UPDATE transactions SET source = NEW.source WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_destination_update
+INSTEAD OF UPDATE OF destination ON security_transactions_view
+BEGIN
+    UPDATE transactions SET destination = NEW.destination WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_unit_price_update
+INSTEAD OF UPDATE OF unit_price ON security_transactions_view
+BEGIN
+    UPDATE security_transactions SET unit_price = NEW.unit_price WHERE transaction_id = NEW.id;
+END;
+
+CREATE TRIGGER st_quantity_update
+INSTEAD OF UPDATE OF quantity ON security_transactions_view
+BEGIN
+    UPDATE security_transactions SET quantity = NEW.quantity WHERE transaction_id = NEW.id;
+END;
+
+CREATE TRIGGER st_delete
+INSTEAD OF DELETE ON security_transactions_view
+BEGIN
+    DELETE FROM transactions WHERE id = OLD.id;
+END;
@@ -0,0 +1,122 @@
+pragma user_version = 4;
+
+
+-- Current balance of each account (in cents), kept up to date by the triggers below so that it
+-- never has to be summed from the account's transactions. Money moves from a transaction's
+-- source account into its destination account
+CREATE TABLE account_balances (
+    account_id INTEGER PRIMARY KEY REFERENCES accounts ON DELETE CASCADE,
+    balance INTEGER NOT NULL DEFAULT 0
+) STRICT;
+
+INSERT INTO account_balances SELECT id, 0 FROM accounts;
+
+UPDATE account_balances SET balance =
+    (SELECT coalesce(sum(amount), 0) FROM transactions_as_cash_view WHERE destination = account_id)
+    - (SELECT coalesce(sum(amount), 0) FROM transactions_as_cash_view WHERE source = account_id);
+
+CREATE TRIGGER account_balances_add_account
+AFTER INSERT ON accounts
+BEGIN
+    INSERT INTO account_balances(account_id) VALUES (NEW.id);
+END;
+
+CREATE TRIGGER account_balances_cash_insert
+AFTER INSERT ON cash_transactions
+BEGIN
+    UPDATE account_balances SET balance = balance - NEW.amount
+        WHERE account_id = (SELECT source FROM transactions WHERE id = NEW.transaction_id);
+    UPDATE account_balances SET balance = balance + NEW.amount
+        WHERE account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id);
+END;
+
+CREATE TRIGGER account_balances_cash_update
+AFTER UPDATE OF amount ON cash_transactions
+BEGIN
+    UPDATE account_balances SET balance = balance - (NEW.amount - OLD.amount)
+        WHERE account_id = (SELECT source FROM transactions WHERE id = NEW.transaction_id);
+    UPDATE account_balances SET balance = balance + (NEW.amount - OLD.amount)
+        WHERE account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id);
+END;
+
+
+-- When this is the result of a transaction being deleted, the transaction is already gone and
+-- account_balances_transaction_delete has already taken its amount out of the balances
+CREATE TRIGGER account_balances_cash_delete
+AFTER DELETE ON cash_transactions
+BEGIN
+    UPDATE account_balances SET balance = balance + OLD.amount
+        WHERE account_id = (SELECT source FROM transactions WHERE id = OLD.transaction_id);
+    UPDATE account_balances SET balance = balance - OLD.amount
+        WHERE account_id = (SELECT destination FROM transactions WHERE id = OLD.transaction_id);
+END;
+
+
+-- Security transactions are counted at their cash value, rounded the same way as in
+-- transactions_as_cash_view
+CREATE TRIGGER account_balances_security_insert
+AFTER INSERT ON security_transactions
+BEGIN
+    UPDATE account_balances
+        SET balance = balance - (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000
+        WHERE account_id = (SELECT source FROM transactions WHERE id = NEW.transaction_id);
+    UPDATE account_balances
+        SET balance = balance + (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000
+        WHERE account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id);
+END;
+
+CREATE TRIGGER account_balances_security_update
+AFTER UPDATE OF unit_price, quantity ON security_transactions
+BEGIN
+    UPDATE account_balances
+        SET balance = balance
+            + (OLD.unit_price * OLD.quantity + iif(OLD.unit_price * OLD.quantity < 0, -500000, 500000)) / 1000000
+            - (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000
+        WHERE account_id = (SELECT source FROM transactions WHERE id = NEW.transaction_id);
+    UPDATE account_balances
+        SET balance = balance
+            - (OLD.unit_price * OLD.quantity + iif(OLD.unit_price * OLD.quantity < 0, -500000, 500000)) / 1000000
+            + (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000
+        WHERE account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id);
+END;
+
+CREATE TRIGGER account_balances_security_delete
+AFTER DELETE ON security_transactions
+BEGIN
+    UPDATE account_balances
+        SET balance = balance + (OLD.unit_price * OLD.quantity + iif(OLD.unit_price * OLD.quantity < 0, -500000, 500000)) / 1000000
+        WHERE account_id = (SELECT source FROM transactions WHERE id = OLD.transaction_id);
+    UPDATE account_balances
+        SET balance = balance - (OLD.unit_price * OLD.quantity + iif(OLD.unit_price * OLD.quantity < 0, -500000, 500000)) / 1000000
+        WHERE account_id = (SELECT destination FROM transactions WHERE id = OLD.transaction_id);
+END;
+
+
+-- Runs before the delete so that the amount can still be looked up
+CREATE TRIGGER account_balances_transaction_delete
+BEFORE DELETE ON transactions
+BEGIN
+    UPDATE account_balances
+        SET balance = balance + coalesce((SELECT amount FROM transactions_as_cash_view WHERE id = OLD.id), 0)
+        WHERE account_id = OLD.source;
+    UPDATE account_balances
+        SET balance = balance - coalesce((SELECT amount FROM transactions_as_cash_view WHERE id = OLD.id), 0)
+        WHERE account_id = OLD.destination;
+END;
+
+CREATE TRIGGER account_balances_transaction_move
+AFTER UPDATE OF source, destination ON transactions
+BEGIN
+    UPDATE account_balances
+        SET balance = balance + coalesce((SELECT amount FROM transactions_as_cash_view WHERE id = NEW.id), 0)
+        WHERE account_id = OLD.source;
+    UPDATE account_balances
+        SET balance = balance - coalesce((SELECT amount FROM transactions_as_cash_view WHERE id = NEW.id), 0)
+        WHERE account_id = OLD.destination;
+    UPDATE account_balances
+        SET balance = balance - coalesce((SELECT amount FROM transactions_as_cash_view WHERE id = NEW.id), 0)
+        WHERE account_id = NEW.source;
+    UPDATE account_balances
+        SET balance = balance + coalesce((SELECT amount FROM transactions_as_cash_view WHERE id = NEW.id), 0)
+        WHERE account_id = NEW.destination;
+END;
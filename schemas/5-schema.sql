@@ -0,0 +1,60 @@
+pragma user_version = 5;
+
+
+-- Pairs each account with every level of its path, including its own full path, so that
+-- everything under a level of the hierarchy is one range of the primary key. Ancestors are
+-- paths rather than IDs because not every level has to be an account (e.g. "Assets:Bank" when
+-- only "Assets:Bank:Checking" exists). Kept up to date by the triggers below
+CREATE TABLE account_closure (
+    ancestor TEXT NOT NULL,
+    account_id INTEGER NOT NULL REFERENCES accounts ON DELETE CASCADE,
+    PRIMARY KEY (ancestor, account_id)
+) STRICT, WITHOUT ROWID;
+
+
+-- Used when an account is deleted or renamed
+CREATE INDEX account_closure_account_id ON account_closure(account_id);
+
+
+INSERT INTO account_closure
+    WITH RECURSIVE levels(account_id, ancestor, rest) AS (
+        SELECT id, '', name || ':' FROM accounts
+        UNION ALL
+        SELECT account_id, ancestor || iif(ancestor = '', '', ':') || substr(rest, 1, instr(rest, ':') - 1),
+               substr(rest, instr(rest, ':') + 1)
+        FROM levels WHERE rest != ''
+    )
+    SELECT ancestor, account_id FROM levels WHERE ancestor != '';
+
+CREATE TRIGGER account_closure_add_account
+AFTER INSERT ON accounts
+BEGIN
+    INSERT INTO account_closure
+        SELECT ancestor, NEW.id FROM (
+            WITH RECURSIVE levels(ancestor, rest) AS (
+                SELECT '', NEW.name || ':'
+                UNION ALL
+                SELECT ancestor || iif(ancestor = '', '', ':') || substr(rest, 1, instr(rest, ':') - 1),
+                       substr(rest, instr(rest, ':') + 1)
+                FROM levels WHERE rest != ''
+            )
+            SELECT ancestor FROM levels WHERE ancestor != ''
+        );
+END;
+
+CREATE TRIGGER account_closure_rename_account
+AFTER UPDATE OF name ON accounts
+BEGIN
+    DELETE FROM account_closure WHERE account_id = OLD.id;
+    INSERT INTO account_closure
+        SELECT ancestor, NEW.id FROM (
+            WITH RECURSIVE levels(ancestor, rest) AS (
+                SELECT '', NEW.name || ':'
+                UNION ALL
+                SELECT ancestor || iif(ancestor = '', '', ':') || substr(rest, 1, instr(rest, ':') - 1),
+                       substr(rest, instr(rest, ':') + 1)
+                FROM levels WHERE rest != ''
+            )
+            SELECT ancestor FROM levels WHERE ancestor != ''
+        );
+END;
@@ -0,0 +1,140 @@
+pragma user_version = 6;
+
+
+-- One row per account leg of each transaction: the account, the transaction's date, and the
+-- signed cash value (in cents) that the leg adds to the account's balance. Rows are clustered
+-- by account and date so that an account's history is one range of the primary key instead of
+-- a search of both the source and destination columns of transactions. transactions and its
+-- amount tables remain what gets written to; the triggers below keep this table in sync, and
+-- account_balances is now kept up to date from it
+CREATE TABLE postings (
+    account_id INTEGER NOT NULL REFERENCES accounts ON DELETE RESTRICT,
+    date TEXT NOT NULL,
+    transaction_id INTEGER NOT NULL REFERENCES transactions ON DELETE CASCADE,
+    amount INTEGER NOT NULL,
+    PRIMARY KEY (account_id, date, transaction_id)
+) STRICT, WITHOUT ROWID;
+
+
+-- Used when a transaction is changed or deleted
+CREATE INDEX postings_transaction_id ON postings(transaction_id);
+
+
+INSERT INTO postings
+    SELECT source, date, id, -amount FROM transactions_as_cash_view WHERE amount IS NOT NULL
+    UNION ALL
+    SELECT destination, date, id, amount FROM transactions_as_cash_view WHERE amount IS NOT NULL;
+
+DROP TRIGGER account_balances_cash_insert;
+
+DROP TRIGGER account_balances_cash_update;
+
+DROP TRIGGER account_balances_cash_delete;
+
+DROP TRIGGER account_balances_security_insert;
+
+DROP TRIGGER account_balances_security_update;
+
+DROP TRIGGER account_balances_security_delete;
+
+DROP TRIGGER account_balances_transaction_delete;
+
+DROP TRIGGER account_balances_transaction_move;
+
+CREATE TRIGGER account_balances_posting_insert
+AFTER INSERT ON postings
+BEGIN
+    UPDATE account_balances SET balance = balance + NEW.amount WHERE account_id = NEW.account_id;
+END;
+
+CREATE TRIGGER account_balances_posting_update
+AFTER UPDATE OF account_id, amount ON postings
+BEGIN
+    UPDATE account_balances SET balance = balance - OLD.amount WHERE account_id = OLD.account_id;
+    UPDATE account_balances SET balance = balance + NEW.amount WHERE account_id = NEW.account_id;
+END;
+
+CREATE TRIGGER account_balances_posting_delete
+AFTER DELETE ON postings
+BEGIN
+    UPDATE account_balances SET balance = balance - OLD.amount WHERE account_id = OLD.account_id;
+END;
+
+
+-- A transaction's legs are added once its amount is, since the transactions row is always
+-- inserted first
+CREATE TRIGGER postings_cash_insert
+AFTER INSERT ON cash_transactions
+BEGIN
+    INSERT INTO postings
+        SELECT source, date, id, -NEW.amount FROM transactions WHERE id = NEW.transaction_id
+        UNION ALL
+        SELECT destination, date, id, NEW.amount FROM transactions WHERE id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_cash_update
+AFTER UPDATE OF amount ON cash_transactions
+BEGIN
+    UPDATE postings
+        SET amount = iif(account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id),
+                         NEW.amount, -NEW.amount)
+        WHERE transaction_id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_cash_delete
+AFTER DELETE ON cash_transactions
+BEGIN
+    DELETE FROM postings WHERE transaction_id = OLD.transaction_id;
+END;
+
+
+-- Security transactions are counted at their cash value, rounded the same way as in
+-- transactions_as_cash_view
+CREATE TRIGGER postings_security_insert
+AFTER INSERT ON security_transactions
+BEGIN
+    INSERT INTO postings
+        SELECT source, date, id,
+               -((NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000)
+        FROM transactions WHERE id = NEW.transaction_id
+        UNION ALL
+        SELECT destination, date, id,
+               (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000
+        FROM transactions WHERE id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_security_update
+AFTER UPDATE OF unit_price, quantity ON security_transactions
+BEGIN
+    UPDATE postings
+        SET amount = iif(account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id), 1, -1)
+                     * ((NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000)
+        WHERE transaction_id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_security_delete
+AFTER DELETE ON security_transactions
+BEGIN
+    DELETE FROM postings WHERE transaction_id = OLD.transaction_id;
+END;
+
+CREATE TRIGGER postings_transaction_date_update
+AFTER UPDATE OF date ON transactions
+WHEN NEW.date != OLD.date
+BEGIN
+    UPDATE postings SET date = NEW.date WHERE transaction_id = NEW.id;
+END;
+
+
+-- The legs are rebuilt rather than updated in place so that swapping the source and
+-- destination never collides with the primary key
+CREATE TRIGGER postings_transaction_move
+AFTER UPDATE OF source, destination ON transactions
+WHEN NEW.source != OLD.source OR NEW.destination != OLD.destination
+BEGIN
+    DELETE FROM postings WHERE transaction_id = NEW.id;
+    INSERT INTO postings
+        SELECT source, date, id, -amount FROM transactions_as_cash_view WHERE id = NEW.id AND amount IS NOT NULL
+        UNION ALL
+        SELECT destination, date, id, amount FROM transactions_as_cash_view WHERE id = NEW.id AND amount IS NOT NULL;
+END;
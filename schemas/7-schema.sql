@@ -0,0 +1,61 @@
+pragma user_version = 7;
+
+
+-- Marks the legs of security transactions so that a stock account's security transactions
+-- are one range of the postings_security index, without touching the (usually far more
+-- numerous) cash movements of the same account
+ALTER TABLE postings ADD COLUMN security INTEGER NOT NULL DEFAULT 0 CHECK (security IN (0, 1));
+
+UPDATE postings SET security = 1 WHERE transaction_id IN (SELECT transaction_id FROM security_transactions);
+
+CREATE INDEX postings_security ON postings(account_id, date, transaction_id, amount) WHERE security = 1;
+
+DROP TRIGGER postings_cash_insert;
+
+DROP TRIGGER postings_security_insert;
+
+DROP TRIGGER postings_transaction_move;
+
+
+-- A transaction's legs are added once its amount is, since the transactions row is always
+-- inserted first
+CREATE TRIGGER postings_cash_insert
+AFTER INSERT ON cash_transactions
+BEGIN
+    INSERT INTO postings(account_id, date, transaction_id, amount)
+        SELECT source, date, id, -NEW.amount FROM transactions WHERE id = NEW.transaction_id
+        UNION ALL
+        SELECT destination, date, id, NEW.amount FROM transactions WHERE id = NEW.transaction_id;
+END;
+
+
+-- Security transactions are counted at their cash value, rounded the same way as in
+-- transactions_as_cash_view
+CREATE TRIGGER postings_security_insert
+AFTER INSERT ON security_transactions
+BEGIN
+    INSERT INTO postings(account_id, date, transaction_id, amount, security)
+        SELECT source, date, id,
+               -((NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000), 1
+        FROM transactions WHERE id = NEW.transaction_id
+        UNION ALL
+        SELECT destination, date, id,
+               (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000, 1
+        FROM transactions WHERE id = NEW.transaction_id;
+END;
+
+
+-- The legs are rebuilt rather than updated in place so that swapping the source and
+-- destination never collides with the primary key
+CREATE TRIGGER postings_transaction_move
+AFTER UPDATE OF source, destination ON transactions
+WHEN NEW.source != OLD.source OR NEW.destination != OLD.destination
+BEGIN
+    DELETE FROM postings WHERE transaction_id = NEW.id;
+    INSERT INTO postings(account_id, date, transaction_id, amount, security)
+        SELECT source, date, id, -amount, EXISTS (SELECT 1 FROM security_transactions WHERE transaction_id = NEW.id)
+        FROM transactions_as_cash_view WHERE id = NEW.id AND amount IS NOT NULL
+        UNION ALL
+        SELECT destination, date, id, amount, EXISTS (SELECT 1 FROM security_transactions WHERE transaction_id = NEW.id)
+        FROM transactions_as_cash_view WHERE id = NEW.id AND amount IS NOT NULL;
+END;
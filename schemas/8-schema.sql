@@ -0,0 +1,285 @@
+pragma user_version = 8;
+
+
+-- Dates move from ISO 8601 TEXT to INTEGER Julian day numbers (the same numbers as
+-- QDate::toJulianDay()), so that they are compared and indexed as integers and never have to
+-- be parsed when read. transactions_as_cash_view and security_transactions_view still show
+-- (and accept) dates as ISO 8601 text. The views and the triggers that refer to the rebuilt
+-- tables are recreated afterwards
+DROP VIEW transactions_as_cash_view;
+
+DROP VIEW security_transactions_view;
+
+DROP TRIGGER postings_cash_insert;
+
+DROP TRIGGER postings_cash_update;
+
+DROP TRIGGER postings_cash_delete;
+
+DROP TRIGGER postings_security_insert;
+
+DROP TRIGGER postings_security_update;
+
+DROP TRIGGER postings_security_delete;
+
+CREATE TABLE new_transactions (
+    id INTEGER PRIMARY KEY,
+    date INTEGER NOT NULL, -- Julian day
+    description TEXT NOT NULL,
+    source INTEGER NOT NULL REFERENCES accounts ON DELETE RESTRICT,
+    destination INTEGER NOT NULL REFERENCES accounts ON DELETE RESTRICT,
+    CHECK (source != destination)
+) STRICT;
+
+INSERT INTO new_transactions
+    SELECT id, CAST(julianday(date) + 0.5 AS INTEGER), description, source, destination FROM transactions;
+
+DROP TABLE transactions;
+
+ALTER TABLE new_transactions RENAME TO transactions;
+
+
+-- Used to find the transactions that refer to an account when it is deleted
+CREATE INDEX transactions_source_date ON transactions(source, date);
+
+CREATE INDEX transactions_destination_date ON transactions(destination, date);
+
+CREATE TABLE new_postings (
+    account_id INTEGER NOT NULL REFERENCES accounts ON DELETE RESTRICT,
+    date INTEGER NOT NULL, -- Julian day
+    transaction_id INTEGER NOT NULL REFERENCES transactions ON DELETE CASCADE,
+    amount INTEGER NOT NULL,
+    security INTEGER NOT NULL DEFAULT 0 CHECK (security IN (0, 1)),
+    PRIMARY KEY (account_id, date, transaction_id)
+) STRICT, WITHOUT ROWID;
+
+INSERT INTO new_postings
+    SELECT account_id, CAST(julianday(date) + 0.5 AS INTEGER), transaction_id, amount, security FROM postings;
+
+DROP TABLE postings;
+
+ALTER TABLE new_postings RENAME TO postings;
+
+
+-- Used when a transaction is changed or deleted
+CREATE INDEX postings_transaction_id ON postings(transaction_id);
+
+CREATE INDEX postings_security ON postings(account_id, date, transaction_id, amount) WHERE security = 1;
+
+CREATE TRIGGER account_balances_posting_insert
+AFTER INSERT ON postings
+BEGIN
+    UPDATE account_balances SET balance = balance + NEW.amount WHERE account_id = NEW.account_id;
+END;
+
+CREATE TRIGGER account_balances_posting_update
+AFTER UPDATE OF account_id, amount ON postings
+BEGIN
+    UPDATE account_balances SET balance = balance - OLD.amount WHERE account_id = OLD.account_id;
+    UPDATE account_balances SET balance = balance + NEW.amount WHERE account_id = NEW.account_id;
+END;
+
+CREATE TRIGGER account_balances_posting_delete
+AFTER DELETE ON postings
+BEGIN
+    UPDATE account_balances SET balance = balance - OLD.amount WHERE account_id = OLD.account_id;
+END;
+
+
+-- A transaction's legs are added once its amount is, since the transactions row is always
+-- inserted first
+CREATE TRIGGER postings_cash_insert
+AFTER INSERT ON cash_transactions
+BEGIN
+    INSERT INTO postings(account_id, date, transaction_id, amount)
+        SELECT source, date, id, -NEW.amount FROM transactions WHERE id = NEW.transaction_id
+        UNION ALL
+        SELECT destination, date, id, NEW.amount FROM transactions WHERE id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_cash_update
+AFTER UPDATE OF amount ON cash_transactions
+BEGIN
+    UPDATE postings
+        SET amount = iif(account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id),
+                         NEW.amount, -NEW.amount)
+        WHERE transaction_id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_cash_delete
+AFTER DELETE ON cash_transactions
+BEGIN
+    DELETE FROM postings WHERE transaction_id = OLD.transaction_id;
+END;
+
+
+-- Security transactions are counted at their cash value, rounded the same way as in
+-- transactions_as_cash_view
+CREATE TRIGGER postings_security_insert
+AFTER INSERT ON security_transactions
+BEGIN
+    INSERT INTO postings(account_id, date, transaction_id, amount, security)
+        SELECT source, date, id,
+               -((NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000), 1
+        FROM transactions WHERE id = NEW.transaction_id
+        UNION ALL
+        SELECT destination, date, id,
+               (NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000, 1
+        FROM transactions WHERE id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_security_update
+AFTER UPDATE OF unit_price, quantity ON security_transactions
+BEGIN
+    UPDATE postings
+        SET amount = iif(account_id = (SELECT destination FROM transactions WHERE id = NEW.transaction_id), 1, -1)
+                     * ((NEW.unit_price * NEW.quantity + iif(NEW.unit_price * NEW.quantity < 0, -500000, 500000)) / 1000000)
+        WHERE transaction_id = NEW.transaction_id;
+END;
+
+CREATE TRIGGER postings_security_delete
+AFTER DELETE ON security_transactions
+BEGIN
+    DELETE FROM postings WHERE transaction_id = OLD.transaction_id;
+END;
+
+CREATE TRIGGER postings_transaction_date_update
+AFTER UPDATE OF date ON transactions
+WHEN NEW.date != OLD.date
+BEGIN
+    UPDATE postings SET date = NEW.date WHERE transaction_id = NEW.id;
+END;
+
+
+-- The legs are rebuilt rather than updated in place so that swapping the source and
+-- destination never collides with the primary key
+CREATE TRIGGER postings_transaction_move
+AFTER UPDATE OF source, destination ON transactions
+WHEN NEW.source != OLD.source OR NEW.destination != OLD.destination
+BEGIN
+    DELETE FROM postings WHERE transaction_id = NEW.id;
+    INSERT INTO postings(account_id, date, transaction_id, amount, security)
+        SELECT NEW.source, NEW.date, NEW.id, -amount, security FROM (
+            SELECT c.amount, EXISTS (SELECT 1 FROM security_transactions WHERE transaction_id = NEW.id) AS security
+            FROM transactions_as_cash_view c WHERE c.id = NEW.id AND c.amount IS NOT NULL
+        )
+        UNION ALL
+        SELECT NEW.destination, NEW.date, NEW.id, amount, security FROM (
+            SELECT c.amount, EXISTS (SELECT 1 FROM security_transactions WHERE transaction_id = NEW.id) AS security
+            FROM transactions_as_cash_view c WHERE c.id = NEW.id AND c.amount IS NOT NULL
+        );
+END;
+
+
+-- Shows all transactions in terms of cash value (in cents). The value of a security
+-- transaction is rounded half away from zero to the nearest cent. Dates are shown as ISO 8601
+-- text, and can be given either that way or as Julian days
+CREATE VIEW transactions_as_cash_view (id, date, description, source, destination, amount) AS
+    SELECT t.id, date(t.date - 0.5), t.description, t.source, t.destination,
+           iif(ct.amount IS NULL,
+               (st.unit_price * st.quantity + iif(st.unit_price * st.quantity < 0, -500000, 500000)) / 1000000,
+               ct.amount)
+    FROM transactions t
+    LEFT JOIN cash_transactions ct ON ct.transaction_id = t.id
+    LEFT JOIN security_transactions st ON st.transaction_id = t.id;
+
+CREATE TRIGGER tac_add_row
+INSTEAD OF INSERT ON transactions_as_cash_view
+BEGIN
+    INSERT INTO transactions(date, description, source, destination)
+        VALUES (CAST(julianday(NEW.date) + 0.5 AS INTEGER), NEW.description, NEW.source, NEW.destination);
+    INSERT INTO cash_transactions VALUES (last_insert_rowid(), NEW.amount);
+END;
+
+CREATE TRIGGER tac_date_update
+INSTEAD OF UPDATE OF date ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET date = CAST(julianday(NEW.date) + 0.5 AS INTEGER) WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_description_update
+INSTEAD OF UPDATE OF description ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET description = NEW.description WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_source_update
+INSTEAD OF UPDATE OF source ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET source = NEW.source WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_destination_update
+INSTEAD OF UPDATE OF destination ON transactions_as_cash_view
+BEGIN
+    UPDATE transactions SET destination = NEW.destination WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER tac_amount_update
+INSTEAD OF UPDATE OF amount ON transactions_as_cash_view
+BEGIN
+    UPDATE cash_transactions SET amount = NEW.amount WHERE transaction_id = NEW.id;
+END;
+
+CREATE TRIGGER tac_delete
+INSTEAD OF DELETE ON transactions_as_cash_view
+BEGIN
+    DELETE FROM transactions WHERE id = OLD.id;
+END;
+
+
+-- Shows all transactions involving securities
+CREATE VIEW security_transactions_view (id, date, description, source, destination, unit_price, quantity) AS
+    SELECT t.id, date(t.date - 0.5), t.description, t.source, t.destination, st.unit_price, st.quantity
+    FROM transactions t
+    LEFT JOIN security_transactions st ON st.transaction_id = t.id;
+
+CREATE TRIGGER st_add_row
+INSTEAD OF INSERT ON security_transactions_view
+BEGIN
+    INSERT INTO transactions(date, description, source, destination)
+        VALUES (CAST(julianday(NEW.date) + 0.5 AS INTEGER), NEW.description, NEW.source, NEW.destination);
+    INSERT INTO security_transactions VALUES (last_insert_rowid(), NEW.unit_price, NEW.quantity);
+END;
+
+CREATE TRIGGER st_date_update
+INSTEAD OF UPDATE OF date ON security_transactions_view
+BEGIN
+    UPDATE transactions SET date = CAST(julianday(NEW.date) + 0.5 AS INTEGER) WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_description_update
+INSTEAD OF UPDATE OF description ON security_transactions_view
+BEGIN
+    UPDATE transactions SET description = NEW.description WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_source_update
+INSTEAD OF UPDATE OF source ON security_transactions_view
+BEGIN
+    UPDATE transactions SET source = NEW.source WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_destination_update
+INSTEAD OF UPDATE OF destination ON security_transactions_view
+BEGIN
+    UPDATE transactions SET destination = NEW.destination WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER st_unit_price_update
+INSTEAD OF UPDATE OF unit_price ON security_transactions_view
+BEGIN
+    UPDATE security_transactions SET unit_price = NEW.unit_price WHERE transaction_id = NEW.id;
+END;
+
+CREATE TRIGGER st_quantity_update
+INSTEAD OF UPDATE OF quantity ON security_transactions_view
+BEGIN
+    UPDATE security_transactions SET quantity = NEW.quantity WHERE transaction_id = NEW.id;
+END;
+
+CREATE TRIGGER st_delete
+INSTEAD OF DELETE ON security_transactions_view
+BEGIN
+    DELETE FROM transactions WHERE id = OLD.id;
+END;
@@ -0,0 +1,9 @@
+pragma user_version = 9;
+
+
+-- The ledger account that each account found in imported OFX files is recorded in. OFX
+-- account IDs are the ones that libofx builds from the bank ID, branch ID, and account number
+CREATE TABLE ofx_accounts (
+    ofx_account_id TEXT PRIMARY KEY,
+    account_id INTEGER NOT NULL REFERENCES accounts ON DELETE CASCADE
+) STRICT;
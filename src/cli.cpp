@@ -0,0 +1,419 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDate>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QTextStream>
+#include "import/CsvImporter.hpp"
+#ifdef WITH_OFX
+#include "import/OfxImporter.hpp"
+#endif
+#include "models/DatabaseManager.hpp"
+#include "models/Money.hpp"
+#include "models/SQLColumns.hpp"
+#include "util/sql_helpers.hpp"
+
+using namespace Qt::StringLiterals;
+
+static const QString commands_help = uR"(Commands:
+  import <database> <path>     Import an OFX/QFX file, a directory of them, or a CSV file
+                               (which needs --account)
+  export <database>            Write transactions as CSV
+  balance <database> [account...]
+                               Print the balances of accounts, including their subaccounts
+  report <database>            Print income and expenses by account)"_s;
+
+// A command's arguments didn't make sense
+struct UsageError : public std::runtime_error {
+    using runtime_error::runtime_error;
+};
+
+static
+bool load_database(DatabaseManager& db_manager, const QString& database_path)
+{
+    QEventLoop loop;
+    bool loaded = false;
+    QObject::connect(&db_manager, &DatabaseManager::database_loaded, &loop, [&] {
+        loaded = true;
+        loop.quit();
+    });
+    QObject::connect(&db_manager, &DatabaseManager::failed_to_load_database, &loop, [&](const QString& err_message) {
+        std::cerr << "Error: " << err_message.toStdString() << "\n";
+        loop.quit();
+    });
+    db_manager.load_database(database_path);
+    loop.exec();
+    return loaded;
+}
+
+static
+int account_id(const QSqlDatabase& db, const QString& path)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT id FROM accounts WHERE name = ?"_s);
+    query.addBindValue(path);
+    sql_helpers::exec(query);
+    if(!query.next()) {
+        query.finish();
+        throw UsageError("No account named " + path.toStdString());
+    }
+    auto id = query.value(0).toInt();
+    query.finish();
+    return id;
+}
+
+// Julian day of a --from/--to option, or default_day if it wasn't given
+static
+qint64 day_option(const QCommandLineParser& parser, const QString& option, qint64 default_day)
+{
+    if(!parser.isSet(option)) {
+        return default_day;
+    }
+    auto date = QDate::fromString(parser.value(option), Qt::ISODate);
+    if(!date.isValid()) {
+        throw UsageError("--" + option.toStdString() + " must be a date like 2025-01-31");
+    }
+    return date.toJulianDay();
+}
+
+static
+int int_option(const QCommandLineParser& parser, const QString& option, int default_value)
+{
+    if(!parser.isSet(option)) {
+        return default_value;
+    }
+    bool ok = false;
+    auto value = parser.value(option).toInt(&ok);
+    if(!ok || value < 0) {
+        throw UsageError("--" + option.toStdString() + " must be a column number (counting from 0)");
+    }
+    return value;
+}
+
+static
+char char_option(const QCommandLineParser& parser, const QString& option, char default_value)
+{
+    if(!parser.isSet(option)) {
+        return default_value;
+    }
+    auto value = parser.value(option);
+    if(value == u"\\t") {
+        return '\t';
+    } else if(value.size() != 1 || value[0].unicode() > 0x7f) {
+        throw UsageError("--" + option.toStdString() + " must be a single ASCII character");
+    }
+    return static_cast<char>(value[0].unicode());
+}
+
+static
+CsvFormat csv_format(const QCommandLineParser& parser)
+{
+    CsvFormat format;
+    format.date_column = int_option(parser, u"date-column"_s, format.date_column);
+    format.description_column = int_option(parser, u"description-column"_s, format.description_column);
+    format.amount_column = int_option(parser, u"amount-column"_s, format.amount_column);
+    format.delimiter = char_option(parser, u"delimiter"_s, format.delimiter);
+    format.decimal_separator = char_option(parser, u"decimal-separator"_s, format.decimal_separator);
+    if(parser.isSet(u"date-order"_s)) {
+        auto order = parser.value(u"date-order"_s).toLower();
+        if(order == u"ymd") {
+            format.date_order = DateOrder::YearMonthDay;
+        } else if(order == u"mdy") {
+            format.date_order = DateOrder::MonthDayYear;
+        } else if(order == u"dmy") {
+            format.date_order = DateOrder::DayMonthYear;
+        } else {
+            throw UsageError("--date-order must be ymd, mdy, or dmy");
+        }
+    }
+    format.has_header = !parser.isSet(u"no-header"_s);
+    return format;
+}
+
+static
+void print_progress(qint64 count)
+{
+    std::cerr << "\rWritten " << count << " transactions" << std::flush;
+}
+
+static
+void run_import(const QSqlDatabase& db, const QCommandLineParser& parser, const QStringList& args)
+{
+    if(args.size() != 1) {
+        throw UsageError("import takes the path of one file or directory");
+    }
+    QFileInfo file_info{args[0]};
+    if(!file_info.exists()) {
+        throw UsageError(args[0].toStdString() + " doesn't exist");
+    }
+    auto suffix = file_info.suffix().toLower();
+    if(file_info.isFile() && suffix == u"csv") {
+        if(!parser.isSet(u"account"_s)) {
+            throw UsageError("Importing a CSV file needs --account");
+        }
+        auto target_account_id = account_id(db, parser.value(u"account"_s));
+        CsvImporter importer{db, csv_format(parser)};
+        QObject::connect(&importer, &CsvImporter::progress, print_progress);
+        auto count = importer.import_file(file_info.filePath(), target_account_id);
+        std::cerr << "\n";
+        std::cout << "Imported " << count << " transactions\n";
+        return;
+    }
+#ifdef WITH_OFX
+    OfxImporter importer{db};
+    QObject::connect(&importer, &OfxImporter::progress, print_progress);
+    if(file_info.isDir()) {
+        auto result = importer.import_directory(file_info.filePath());
+        std::cerr << "\n";
+        for(const auto& failure : result.failed_files) {
+            std::cerr << "Skipped " << failure.toStdString() << "\n";
+        }
+        std::cout << "Imported " << result.imported_count << " transactions (" << result.transfer_count
+                  << " as transfers), skipped " << result.duplicate_count << " already imported\n";
+        if(!result.failed_files.empty()) {
+            throw std::runtime_error(std::to_string(result.failed_files.size()) + " files couldn't be read");
+        }
+    } else if(suffix == u"ofx" || suffix == u"qfx") {
+        auto count = importer.import_file(file_info.filePath());
+        std::cerr << "\n";
+        std::cout << "Imported " << count << " transactions\n";
+    } else {
+        throw UsageError("Only .csv, .ofx, and .qfx files can be imported");
+    }
+#else
+    throw UsageError("Only .csv files can be imported (this build doesn't support OFX)");
+#endif
+}
+
+// Quotes a CSV field if needed
+static
+QString csv_field(const QString& text)
+{
+    if(!text.contains(u',') && !text.contains(u'"') && !text.contains(u'\n') && !text.contains(u'\r')) {
+        return text;
+    }
+    auto quoted = text;
+    quoted.replace(u"\""_s, u"\"\""_s);
+    return u'"' + quoted + u'"';
+}
+
+static
+void run_export(const QSqlDatabase& db, const QCommandLineParser& parser, const QStringList& args)
+{
+    if(!args.empty()) {
+        throw UsageError("export doesn't take any paths (use --output)");
+    }
+    auto first_day = day_option(parser, u"from"_s, std::numeric_limits<qint64>::min());
+    auto last_day = day_option(parser, u"to"_s, std::numeric_limits<qint64>::max());
+    QFile output;
+    bool opened;
+    if(parser.isSet(u"output"_s)) {
+        output.setFileName(parser.value(u"output"_s));
+        opened = output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = output.open(stdout, QIODevice::WriteOnly);
+    }
+    if(!opened) {
+        throw std::runtime_error("Failed to open output: " + output.errorString().toStdString());
+    }
+    QTextStream out{&output};
+
+    // The amount is read from the destination's posting (an index lookup) instead of the
+    // cash and security tables
+    auto query_text = u"SELECT t.date, t.description, s.name, d.name,"
+                       " (SELECT p.amount FROM postings p WHERE p.account_id = t.destination AND p.date = t.date"
+                       "  AND p.transaction_id = t.id)"
+                       " FROM transactions t JOIN accounts s ON s.id = t.source JOIN accounts d ON d.id = t.destination"
+                       " WHERE t.date BETWEEN ? AND ?"_s;
+    if(parser.isSet(u"account"_s)) {
+        // Anything in the account's subtree
+        query_text += u" AND t.id IN (SELECT p.transaction_id FROM account_closure c"
+                       " JOIN postings p ON p.account_id = c.account_id"
+                       " WHERE c.ancestor = ? AND p.date BETWEEN ? AND ?)"_s;
+    }
+    query_text += u" ORDER BY t.date, t.id"_s;
+    QSqlQuery query{db};
+    query.setForwardOnly(true);
+    sql_helpers::prepare(query, query_text);
+    query.addBindValue(first_day);
+    query.addBindValue(last_day);
+    if(parser.isSet(u"account"_s)) {
+        auto account = parser.value(u"account"_s);
+        // Fail on a typo instead of exporting nothing
+        account_id(db, account);
+        query.addBindValue(account);
+        query.addBindValue(first_day);
+        query.addBindValue(last_day);
+    }
+    sql_helpers::exec(query);
+    out << "date,description,source,destination,amount\n";
+    while(query.next()) {
+        out << QDate::fromJulianDay(query.value(0).toLongLong()).toString(Qt::ISODate) << ','
+            << csv_field(query.value(1).toString()) << ','
+            << csv_field(query.value(2).toString()) << ','
+            << csv_field(query.value(3).toString()) << ','
+            << Money::from_units(query.value(4).toLongLong()).to_string() << '\n';
+    }
+    out.flush();
+    if(out.status() != QTextStream::Ok) {
+        throw std::runtime_error("Failed to write output: " + output.errorString().toStdString());
+    }
+}
+
+static
+void run_balance(const QSqlDatabase& db, const QStringList& args)
+{
+    auto query_text = u"SELECT a.name, (SELECT coalesce(sum(b.balance), 0) FROM account_closure c"
+                       " JOIN account_balances b ON b.account_id = c.account_id WHERE c.ancestor = a.name)"
+                       " FROM accounts a"_s;
+    QSqlQuery query{db};
+    query.setForwardOnly(true);
+    auto print_row = [&query] {
+        std::cout << query.value(0).toString().toStdString() << "\t"
+                  << Money::from_units(query.value(1).toLongLong()).to_string().toStdString() << "\n";
+    };
+    if(args.empty()) {
+        sql_helpers::exec(query, query_text + u" ORDER BY a.name"_s);
+        while(query.next()) {
+            print_row();
+        }
+        return;
+    }
+    sql_helpers::prepare(query, query_text + u" WHERE a.name = ?"_s);
+    for(const auto& account : args) {
+        query.addBindValue(account);
+        sql_helpers::exec(query);
+        if(!query.next()) {
+            throw UsageError("No account named " + account.toStdString());
+        }
+        print_row();
+        query.finish();
+    }
+}
+
+static
+void run_report(const QSqlDatabase& db, const QCommandLineParser& parser, const QStringList& args)
+{
+    if(!args.empty()) {
+        throw UsageError("report doesn't take any accounts (use export --account)");
+    }
+    auto first_day = day_option(parser, u"from"_s, std::numeric_limits<qint64>::min());
+    auto last_day = day_option(parser, u"to"_s, std::numeric_limits<qint64>::max());
+    QSqlQuery query{db};
+    query.setForwardOnly(true);
+    // Each account's postings are read through its (account_id, date) key
+    sql_helpers::prepare(query, u"SELECT a.name, sum(p.amount) FROM accounts a"
+                                 " JOIN postings p ON p.account_id = a.id AND p.date BETWEEN ? AND ?"
+                                 " WHERE a.kind = ? GROUP BY a.id ORDER BY a.name"_s);
+    Money net;
+    for(auto [kind, title] : {std::pair{ACCOUNT_KIND_INCOME, "Income"}, std::pair{ACCOUNT_KIND_EXPENSE, "Expenses"}}) {
+        query.addBindValue(first_day);
+        query.addBindValue(last_day);
+        query.addBindValue(static_cast<int>(kind));
+        sql_helpers::exec(query);
+        std::cout << title << "\n";
+        Money total;
+        while(query.next()) {
+            auto amount = Money::from_units(query.value(1).toLongLong());
+            // Income accounts are the source of the money they bring in, so their postings are negative
+            if(kind == ACCOUNT_KIND_INCOME) {
+                amount = -amount;
+            }
+            total += amount;
+            std::cout << "  " << query.value(0).toString().toStdString() << "\t" << amount.to_string().toStdString() << "\n";
+        }
+        query.finish();
+        std::cout << "Total " << QString::fromLatin1(title).toLower().toStdString() << "\t" << total.to_string().toStdString() << "\n";
+        net += kind == ACCOUNT_KIND_INCOME ? total : -total;
+    }
+    std::cout << "Net\t" << net.to_string().toStdString() << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app{argc, argv};
+    QCommandLineParser parser;
+    parser.setApplicationDescription(u"Command-line interface to QAccountant databases\n\n"_s + commands_help);
+    parser.addHelpOption();
+    parser.addPositionalArgument(u"command"_s, u"import, export, balance, or report"_s);
+    parser.addPositionalArgument(u"database"_s, u"Path of the database"_s);
+    parser.addOptions({
+        {u"account"_s, u"Account to import a CSV file into, or to export (with its subaccounts)"_s, u"path"_s},
+        {u"from"_s, u"First date to export or report on"_s, u"yyyy-mm-dd"_s},
+        {u"to"_s, u"Last date to export or report on"_s, u"yyyy-mm-dd"_s},
+        {u"output"_s, u"File to export to (instead of standard output)"_s, u"path"_s},
+        {u"date-column"_s, u"CSV column of the date (counting from 0, default 0)"_s, u"column"_s},
+        {u"description-column"_s, u"CSV column of the description (default 1)"_s, u"column"_s},
+        {u"amount-column"_s, u"CSV column of the amount (default 2)"_s, u"column"_s},
+        {u"delimiter"_s, u"CSV field delimiter (default ',', or \\t for tabs)"_s, u"char"_s},
+        {u"decimal-separator"_s, u"Decimal separator in CSV amounts (default '.')"_s, u"char"_s},
+        {u"date-order"_s, u"Order of CSV dates: ymd (default), mdy, or dmy"_s, u"order"_s},
+        {u"no-header"_s, u"The CSV file has no header row"_s},
+    });
+    parser.process(app);
+    auto args = parser.positionalArguments();
+    if(args.size() < 2) {
+        std::cerr << parser.helpText().toStdString() << "\n";
+        return 1;
+    }
+    auto command = args.takeFirst();
+    auto database_path = args.takeFirst();
+    if(command != u"import" && command != u"export" && command != u"balance" && command != u"report") {
+        std::cerr << "Error: unknown command '" << command.toStdString() << "'\n\n" << commands_help.toStdString() << "\n";
+        return 1;
+    }
+    if(!QFileInfo::exists(database_path)) {
+        // Otherwise SQLite would create an empty one
+        std::cerr << "Error: " << database_path.toStdString() << " doesn't exist\n";
+        return 1;
+    }
+
+    DatabaseManager db_manager;
+    if(!load_database(db_manager, database_path)) {
+        return 1;
+    }
+    const auto& db = db_manager.database();
+    try {
+        if(command == u"import") {
+            run_import(db, parser, args);
+        } else if(command == u"export") {
+            run_export(db, parser, args);
+        } else if(command == u"balance") {
+            run_balance(db, args);
+        } else {
+            run_report(db, parser, args);
+        }
+    } catch(const UsageError& err) {
+        std::cerr << "Error: " << err.what() << "\n";
+        return 1;
+    } catch(const std::exception& err) {
+        std::cerr << "Error: " << err.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
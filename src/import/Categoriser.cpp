@@ -0,0 +1,100 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Categoriser.hpp"
+#include <utility>
+#include <vector>
+#include <QSqlQuery>
+#include "util/sql_helpers.hpp"
+
+using namespace Qt::StringLiterals;
+
+static const QString uncategorized_income_path = u"Income:Uncategorized"_s;
+static const QString uncategorized_expense_path = u"Expenses:Uncategorized"_s;
+
+Categoriser::Categoriser(const QSqlDatabase& db)
+    : m_matcher(RuleMatcher::load(db)),
+      m_income_account_id(find_or_create_account(db, uncategorized_income_path, ACCOUNT_KIND_INCOME)),
+      m_expense_account_id(find_or_create_account(db, uncategorized_expense_path, ACCOUNT_KIND_EXPENSE))
+{}
+
+ImportedTransaction Categoriser::categorise(qint64 date, QString description, int account_id, qint64 amount) const
+{
+    auto other_account_id = m_matcher.match(description);
+    if(other_account_id == 0 || other_account_id == account_id) {
+        other_account_id = amount < 0 ? m_expense_account_id : m_income_account_id;
+    }
+    if(amount < 0) {
+        return ImportedTransaction{date, std::move(description), account_id, other_account_id, -amount};
+    }
+    return ImportedTransaction{date, std::move(description), other_account_id, account_id, amount};
+}
+
+qint64 recategorise_transactions(const QSqlDatabase& db)
+{
+    auto matcher = RuleMatcher::load(db);
+    if(matcher.empty()) {
+        return 0;
+    }
+    struct Change {
+        qint64 transaction_id;
+        int account_id;
+    };
+    std::vector<Change> source_changes;
+    std::vector<Change> destination_changes;
+    QSqlQuery query{db};
+    query.setForwardOnly(true);
+    // Only the changes are kept, not the descriptions, so this doesn't need much memory even when
+    // there are millions of transactions
+    // Transactions between the two Uncategorized accounts are left alone, since there's no telling
+    // which side a rule is for
+    sql_helpers::prepare(query, u"SELECT t.id, t.description, t.source = a.id, a.id, o.id"
+                                 " FROM accounts a JOIN postings p ON p.account_id = a.id"
+                                 " JOIN transactions t ON t.id = p.transaction_id"
+                                 " JOIN accounts o ON o.id = iif(t.source = a.id, t.destination, t.source)"
+                                 " WHERE a.name IN (?, ?) AND o.name NOT IN (?, ?)"_s);
+    for(int i = 0; i < 2; ++i) {
+        query.addBindValue(uncategorized_income_path);
+        query.addBindValue(uncategorized_expense_path);
+    }
+    sql_helpers::exec(query);
+    while(query.next()) {
+        auto account_id = matcher.match(query.value(1).toString());
+        if(account_id == 0 || account_id == query.value(3).toInt() || account_id == query.value(4).toInt()) {
+            continue;
+        }
+        auto& changes = query.value(2).toBool() ? source_changes : destination_changes;
+        changes.push_back(Change{query.value(0).toLongLong(), account_id});
+    }
+    query.finish();
+
+    sql_helpers::Transaction transaction{db};
+    auto update = [&db](const std::vector<Change>& changes, QString column) {
+        sql_helpers::exec_batched(db, changes.size(), 2, [&column](size_t count) {
+            return u"UPDATE transactions SET %1 = c.column2 FROM (VALUES %2) AS c WHERE transactions.id = c.column1"_s
+                   .arg(column, sql_helpers::values_placeholders(count, 2));
+        }, [&changes](QSqlQuery& query, size_t i) {
+            query.addBindValue(changes[i].transaction_id);
+            query.addBindValue(changes[i].account_id);
+        });
+    };
+    update(source_changes, u"source"_s);
+    update(destination_changes, u"destination"_s);
+    transaction.commit();
+    return static_cast<qint64>(source_changes.size() + destination_changes.size());
+}
@@ -0,0 +1,53 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QSqlDatabase>
+#include <QString>
+#include "LedgerWriter.hpp"
+#include "RuleMatcher.hpp"
+
+/* Picks the other side of imported transactions: the account of the categorisation rule that
+   matches the description (see RuleMatcher), or if there isn't one, Income:Uncategorized for
+   money coming in and Expenses:Uncategorized for money going out. categorise() can be called
+   from several threads at once */
+class Categoriser {
+public:
+    // Loads the rules and finds (or creates) the Uncategorized accounts. Throws sql_helpers::Error
+    explicit
+    Categoriser(const QSqlDatabase&);
+
+    // Returns a transaction between account_id and the account picked for it. amount is in cents,
+    // and is positive when money goes into account_id
+    ImportedTransaction categorise(qint64 date, QString description, int account_id, qint64 amount) const;
+    // Matches up transactions that categorise() didn't find a rule for
+    TransferMatching transfer_matching() const
+    {
+        return TransferMatching{m_income_account_id, m_expense_account_id};
+    }
+private:
+    RuleMatcher m_matcher;
+    int m_income_account_id;
+    int m_expense_account_id;
+};
+
+// Applies the categorisation rules to the transactions that have Income:Uncategorized or
+// Expenses:Uncategorized on one side, returning how many were moved to another account. Throws
+// sql_helpers::Error
+qint64 recategorise_transactions(const QSqlDatabase&);
@@ -0,0 +1,373 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "CsvImporter.hpp"
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <QDate>
+#include <QFile>
+#include <QFuture>
+#include <QSqlDatabase>
+#include "Categoriser.hpp"
+#include "LedgerWriter.hpp"
+#include "util/sql_helpers.hpp"
+#include "util/thread_pool.hpp"
+
+using namespace Qt::StringLiterals;
+
+// Chunks are extended from this size to the end of the row they stop in
+static constexpr size_t chunk_size = 4 * 1024 * 1024;
+
+struct ParsedChunk {
+    std::vector<ImportedTransaction> rows;
+    qsizetype line_count = 0;
+};
+
+// Thrown while parsing a chunk. line is counted from the start of the chunk
+struct ChunkError : public std::runtime_error {
+    ChunkError(qsizetype line, const char* message)
+        : runtime_error(message), line(line)
+    {}
+
+    qsizetype line;
+};
+
+// The text of one field of a row, without any quotes around it. Quotes inside a quoted field are
+// still doubled
+struct Field {
+    std::string_view text;
+    bool quoted;
+};
+
+static
+bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Returns the end of the chunk starting at start: the end of the row that contains the byte
+// chunk_size bytes later. start must be the start of a row
+static
+size_t chunk_end(std::string_view data, size_t start)
+{
+    if(data.size() - start <= chunk_size) {
+        return data.size();
+    }
+    auto pos = start + chunk_size;
+    // Quotes come in pairs within a row, so after an odd number of them we're inside a quoted field
+    bool in_quotes = std::count(data.begin() + start, data.begin() + pos, '"') % 2 != 0;
+    for(; pos < data.size(); ++pos) {
+        if(data[pos] == '"') {
+            in_quotes = !in_quotes;
+        } else if(data[pos] == '\n' && !in_quotes) {
+            return pos + 1;
+        }
+    }
+    return data.size();
+}
+
+// Splits the row starting at pos into fields, returning the start of the next row
+static
+size_t split_row(std::string_view data, size_t pos, char delimiter, std::vector<Field>& fields, qsizetype& line_count)
+{
+    const char field_ends[] = {delimiter, '\n'};
+    fields.clear();
+    while(true) {
+        Field field{{}, false};
+        if(pos < data.size() && data[pos] == '"') {
+            field.quoted = true;
+            auto start = ++pos;
+            while(true) {
+                auto quote = data.find('"', pos);
+                if(quote == std::string_view::npos) {
+                    throw ChunkError(line_count, "Quoted field is never closed");
+                }
+                line_count += std::count(data.begin() + pos, data.begin() + quote, '\n');
+                // A doubled quote is a quote inside the field
+                if(quote + 1 < data.size() && data[quote + 1] == '"') {
+                    pos = quote + 2;
+                    continue;
+                }
+                field.text = data.substr(start, quote - start);
+                pos = quote + 1;
+                break;
+            }
+            if(pos < data.size() && data[pos] == '\r') {
+                ++pos;
+            }
+        } else {
+            auto end = std::min(data.find_first_of(std::string_view{field_ends, 2}, pos), data.size());
+            field.text = data.substr(pos, end - pos);
+            if(end == data.size() || data[end] == '\n') {
+                if(field.text.ends_with('\r')) {
+                    field.text.remove_suffix(1);
+                }
+            }
+            pos = end;
+        }
+        fields.push_back(field);
+
+        if(pos == data.size()) {
+            return pos;
+        } else if(data[pos] == delimiter) {
+            ++pos;
+        } else if(data[pos] == '\n') {
+            ++line_count;
+            return pos + 1;
+        } else {
+            throw ChunkError(line_count, "Unexpected text after a quoted field");
+        }
+    }
+}
+
+// Reads the three numbers of a date, e.g. "2025-01-31" or "1/31/2025". Anything after the third
+// number (e.g. a time) is ignored
+static
+std::optional<qint64> parse_date(std::string_view text, DateOrder order)
+{
+    int parts[3];
+    const auto* pos = text.data();
+    const auto* end = text.data() + text.size();
+    for(auto& part : parts) {
+        while(pos != end && !is_digit(*pos)) {
+            ++pos;
+        }
+        auto [next, error] = std::from_chars(pos, end, part);
+        if(error != std::errc{}) {
+            return {};
+        }
+        pos = next;
+    }
+    QDate date;
+    switch(order) {
+    case DateOrder::YearMonthDay:
+        date = QDate(parts[0], parts[1], parts[2]);
+        break;
+    case DateOrder::MonthDayYear:
+        date = QDate(parts[2], parts[0], parts[1]);
+        break;
+    case DateOrder::DayMonthYear:
+        date = QDate(parts[2], parts[1], parts[0]);
+        break;
+    }
+    if(!date.isValid()) {
+        return {};
+    }
+    return date.toJulianDay();
+}
+
+// Reads an amount such as "-1,234.56", "+12", or "(7.50)" (which is negative) in cents. Digits
+// past the cents are rounded half away from zero
+static
+std::optional<qint64> parse_amount(std::string_view text, char decimal_separator)
+{
+    while(!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while(!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    bool negative = false;
+    if(text.starts_with('(') && text.ends_with(')')) {
+        negative = true;
+        text = text.substr(1, text.size() - 2);
+    }
+    if(text.starts_with('-') || text.starts_with('+')) {
+        negative = negative != (text.front() == '-');
+        text.remove_prefix(1);
+    }
+    qint64 cents = 0;
+    // Returns false if the amount no longer fits
+    auto append_digit = [&cents](int digit) {
+        return !__builtin_mul_overflow(cents, 10, &cents) && !__builtin_add_overflow(cents, digit, &cents);
+    };
+    // -1 until the decimal separator is reached
+    int fraction_digits = -1;
+    bool has_digits = false;
+    bool round_up = false;
+    for(char c : text) {
+        if(is_digit(c)) {
+            has_digits = true;
+            if(fraction_digits < 2) {
+                if(!append_digit(c - '0')) {
+                    return {};
+                }
+                if(fraction_digits >= 0) {
+                    ++fraction_digits;
+                }
+            } else if(fraction_digits == 2) {
+                round_up = c >= '5';
+                ++fraction_digits;
+            }
+        } else if(c == decimal_separator && fraction_digits < 0) {
+            fraction_digits = 0;
+        } else if((c == ',' || c == '.' || c == ' ' || c == '\'') && fraction_digits < 0) {
+            // Thousands separator
+        } else {
+            return {};
+        }
+    }
+    if(!has_digits) {
+        return {};
+    }
+    for(int i = std::max(fraction_digits, 0); i < 2; ++i) {
+        if(!append_digit(0)) {
+            return {};
+        }
+    }
+    if(round_up && __builtin_add_overflow(cents, 1, &cents)) {
+        return {};
+    }
+    return negative ? -cents : cents;
+}
+
+// Parses the rows of a chunk into transactions with account_id on one side
+static
+ParsedChunk parse_chunk(std::string_view data, const CsvFormat& format, bool skip_header,
+                        const Categoriser& categoriser, int account_id)
+{
+    ParsedChunk chunk;
+    auto column_count = static_cast<size_t>(
+        std::max({format.date_column, format.description_column, format.amount_column}) + 1);
+    std::vector<Field> fields;
+    size_t pos = 0;
+    while(pos < data.size()) {
+        auto line = chunk.line_count;
+        pos = split_row(data, pos, format.delimiter, fields, chunk.line_count);
+        if(fields.size() == 1 && fields[0].text.empty() && !fields[0].quoted) {
+            // Blank line
+            continue;
+        } else if(skip_header) {
+            skip_header = false;
+            continue;
+        } else if(fields.size() < column_count) {
+            throw ChunkError(line, "Row has too few columns");
+        }
+        auto date = parse_date(fields[format.date_column].text, format.date_order);
+        if(!date) {
+            throw ChunkError(line, "Invalid date");
+        }
+        auto amount = parse_amount(fields[format.amount_column].text, format.decimal_separator);
+        if(!amount) {
+            throw ChunkError(line, "Invalid amount");
+        }
+        const auto& description_field = fields[format.description_column];
+        auto description = QString::fromUtf8(description_field.text.data(), description_field.text.size());
+        if(description_field.quoted) {
+            description.replace(u"\"\""_s, u"\""_s);
+        }
+        chunk.rows.push_back(categoriser.categorise(*date, std::move(description), account_id, *amount));
+    }
+    return chunk;
+}
+
+struct CsvImporter::Impl {
+    QSqlDatabase db;
+    CsvFormat format;
+};
+
+CsvImporter::CsvImporter(const QSqlDatabase& db, CsvFormat format)
+    : m_impl(new Impl{db, format})
+{}
+
+CsvImporter::~CsvImporter() noexcept
+{
+    delete m_impl;
+}
+
+qint64 CsvImporter::import_file(const QString& path, int account_id)
+{
+    const auto& format = m_impl->format;
+    if(format.date_column < 0 || format.description_column < 0 || format.amount_column < 0) {
+        throw std::runtime_error("Column numbers can't be negative");
+    }
+    // Shared with the parsing tasks so that the file stays mapped until they are all done, even
+    // if this function exits early
+    auto file = std::make_shared<QFile>(path);
+    if(!file->open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Failed to open " + path.toStdString() + ": " + file->errorString().toStdString());
+    }
+    std::string_view data;
+    if(file->size() > 0) {
+        const auto* contents = file->map(0, file->size());
+        if(!contents) {
+            throw std::runtime_error("Failed to map " + path.toStdString() + ": " + file->errorString().toStdString());
+        }
+        data = {reinterpret_cast<const char*>(contents), static_cast<size_t>(file->size())};
+    }
+    if(data.starts_with("\xEF\xBB\xBF")) {
+        // UTF-8 byte order mark
+        data.remove_prefix(3);
+    }
+
+    const auto& db = m_impl->db;
+    auto categoriser = std::make_shared<const Categoriser>(db);
+    LedgerWriter writer{db, LedgerWriter::default_batch_size, LedgerWriter::CommitMode::AtEnd};
+    writer.match_transfers(categoriser->transfer_matching());
+
+    auto max_parsing = thread_pool::max_tasks_ahead();
+    std::deque<QFuture<ParsedChunk>> parsing;
+    size_t next_chunk = 0;
+    auto parse_more = [&] {
+        while(next_chunk < data.size() && parsing.size() < max_parsing) {
+            auto end = chunk_end(data, next_chunk);
+            bool skip_header = next_chunk == 0 && format.has_header;
+            parsing.push_back(thread_pool::run([file, chunk = data.substr(next_chunk, end - next_chunk), format, skip_header,
+                                                categoriser, account_id] {
+                return parse_chunk(chunk, format, skip_header, *categoriser, account_id);
+            }));
+            next_chunk = end;
+        }
+    };
+    parse_more();
+
+    // Lines before the chunk being written
+    qsizetype line_count = 0;
+    while(!parsing.empty()) {
+        auto future = std::move(parsing.front());
+        parsing.pop_front();
+        parse_more();
+        ParsedChunk chunk;
+        try {
+            chunk = future.takeResult();
+        } catch(const ChunkError& err) {
+            throw std::runtime_error("Line " + std::to_string(line_count + err.line + 1) + ": " + err.what());
+        }
+        line_count += chunk.line_count;
+        for(auto& row : chunk.rows) {
+            auto written_before = writer.written_count();
+            writer.add(std::move(row));
+            if(writer.written_count() != written_before) {
+                emit progress(writer.written_count());
+            }
+        }
+    }
+    auto written_before = writer.written_count();
+    writer.commit();
+    if(writer.written_count() != written_before) {
+        emit progress(writer.written_count());
+    }
+    return writer.written_count();
+}
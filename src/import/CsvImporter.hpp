@@ -0,0 +1,72 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QSqlDatabase;
+QT_END_NAMESPACE
+
+enum class DateOrder {
+    YearMonthDay,
+    MonthDayYear,
+    DayMonthYear
+};
+
+// Which columns of a CSV file hold each field of a transaction (counted from 0), and how the
+// fields are written
+struct CsvFormat {
+    int date_column = 0;
+    int description_column = 1;
+    // Positive when money goes into the account
+    int amount_column = 2;
+    char delimiter = ',';
+    char decimal_separator = '.';
+    // The order of the numbers in a date. They can be separated by any non-digit characters
+    DateOrder date_order = DateOrder::YearMonthDay;
+    bool has_header = true;
+};
+
+/* Imports the rows of CSV files into the ledger as cash transactions. The file is memory-mapped
+   and split into chunks, which are parsed in parallel on the global thread pool while earlier
+   chunks are written, so only a few chunks' worth of rows are held in memory at once. The other
+   side of each transaction is picked by a Categoriser (also on the thread pool), or if it's a
+   transfer between accounts, matched up with the other side (see TransferMatching). Must only be
+   used on the thread that owns the connection */
+class CsvImporter : public QObject {
+    Q_OBJECT
+public:
+    CsvImporter(const QSqlDatabase&, CsvFormat);
+    ~CsvImporter() noexcept;
+
+    // Imports every row of the file into the given account in a single transaction, returning
+    // the number of rows imported. Throws std::runtime_error (naming the line) if the file can't
+    // be read or one of its rows can't be parsed, or sql_helpers::Error if writing to the
+    // database fails. Either way, none of the file's rows are imported
+    qint64 import_file(const QString& path, int account_id);
+signals:
+    // Emitted after each batch is written, with the total written so far. Nothing is committed
+    // until the whole file has been written
+    void progress(qint64 written_count);
+private:
+    struct Impl;
+    Impl* m_impl;
+};
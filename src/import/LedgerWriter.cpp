@@ -0,0 +1,410 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "LedgerWriter.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <QSet>
+#include <QSqlQuery>
+#include <QStringList>
+#include "util/sql_helpers.hpp"
+
+using namespace Qt::StringLiterals;
+
+struct LedgerWriter::Impl {
+    struct Counts {
+        qint64 written = 0;
+        qint64 transfers = 0;
+        qint64 duplicates = 0;
+    };
+
+    // Rolls back everything that wasn't committed
+    void roll_back();
+
+    QSqlDatabase db;
+    size_t batch_size;
+    CommitMode commit_mode;
+    std::vector<ImportedTransaction> batch;
+    std::optional<TransferMatching> transfer_matching;
+    Counts counts;
+    Counts committed_counts;
+    // Open while written transactions are waiting to be committed
+    std::optional<sql_helpers::Transaction> transaction;
+};
+
+void LedgerWriter::Impl::roll_back()
+{
+    transaction.reset();
+    counts = committed_counts;
+    batch.clear();
+}
+
+// How the rows of a batch were matched up as transfers
+struct BatchMatches {
+    static constexpr size_t not_merged = static_cast<size_t>(-1);
+
+    explicit
+    BatchMatches(size_t row_count)
+        : merged_into(row_count, not_merged), existing_ids(row_count, 0)
+    {}
+
+    bool is_removed(size_t row) const
+    {
+        return merged_into[row] != not_merged || existing_ids[row] != 0;
+    }
+
+    // The row of the batch that each row was merged into
+    std::vector<size_t> merged_into;
+    // The transaction already in the ledger that each row was merged into (or 0)
+    std::vector<qint64> existing_ids;
+    // Transactions already in the ledger whose Uncategorized side is now another account
+    std::vector<std::pair<qint64, int>> source_changes;
+    std::vector<std::pair<qint64, int>> destination_changes;
+    size_t removed_count = 0;
+};
+
+// Removes the rows whose import key was already imported, or is used by an earlier row of the
+// batch, and returns how many were removed. Each key is looked up on its own, so only the keys of
+// one batch are held in memory. This runs inside the write transaction (which takes the write
+// lock), so no other connection can import the same keys before the batch is written
+static
+size_t remove_imported(const QSqlDatabase& db, std::vector<ImportedTransaction>& batch)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT 1 FROM imported_transactions WHERE account_id = ? AND import_key = ?"_s);
+    QSet<std::pair<int, QString>> batch_keys;
+    size_t kept = 0;
+    for(auto& row : batch) {
+        if(!row.import_key.isEmpty()) {
+            std::pair key{row.import_account, row.import_key};
+            if(batch_keys.contains(key)) {
+                continue;
+            }
+            query.addBindValue(row.import_account);
+            query.addBindValue(row.import_key);
+            sql_helpers::exec(query);
+            bool is_imported = query.next();
+            query.finish();
+            if(is_imported) {
+                continue;
+            }
+            batch_keys.insert(std::move(key));
+        }
+        if(&batch[kept] != &row) {
+            batch[kept] = std::move(row);
+        }
+        ++kept;
+    }
+    auto removed_count = batch.size() - kept;
+    batch.erase(batch.begin() + static_cast<std::ptrdiff_t>(kept), batch.end());
+    return removed_count;
+}
+
+// Money going out of an account to Expenses:Uncategorized
+static
+bool is_outgoing(const ImportedTransaction& row, const TransferMatching& matching)
+{
+    return row.destination == matching.uncategorized_expense_id && row.source != matching.uncategorized_income_id;
+}
+
+// Money coming into an account from Income:Uncategorized
+static
+bool is_incoming(const ImportedTransaction& row, const TransferMatching& matching)
+{
+    return row.source == matching.uncategorized_income_id && row.destination != matching.uncategorized_expense_id;
+}
+
+// Merges each incoming row into the outgoing row with the same amount that is closest in date
+static
+void match_within_batch(std::vector<ImportedTransaction>& batch, const TransferMatching& matching, BatchMatches& matches)
+{
+    std::unordered_map<qint64, std::vector<size_t>> incoming_rows;
+    for(size_t row = 0; row < batch.size(); ++row) {
+        if(is_incoming(batch[row], matching)) {
+            incoming_rows[batch[row].amount].push_back(row);
+        }
+    }
+    if(incoming_rows.empty()) {
+        return;
+    }
+    for(size_t row = 0; row < batch.size(); ++row) {
+        if(!is_outgoing(batch[row], matching)) {
+            continue;
+        }
+        auto it = incoming_rows.find(batch[row].amount);
+        if(it == incoming_rows.end()) {
+            continue;
+        }
+        auto& candidates = it->second;
+        auto best = candidates.end();
+        qint64 best_gap = 0;
+        for(auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+            auto gap = std::abs(batch[*candidate].date - batch[row].date);
+            if(gap <= matching.window_days && batch[*candidate].destination != batch[row].source
+               && (best == candidates.end() || gap < best_gap)) {
+                best = candidate;
+                best_gap = gap;
+            }
+        }
+        if(best == candidates.end()) {
+            continue;
+        }
+        batch[row].destination = batch[*best].destination;
+        matches.merged_into[*best] = row;
+        ++matches.removed_count;
+        *best = candidates.back();
+        candidates.pop_back();
+    }
+}
+
+// Merges each row that is still one side of a possible transfer into the closest (in date)
+// transaction already in the ledger that could be the other side
+static
+void match_with_ledger(const QSqlDatabase& db, const std::vector<ImportedTransaction>& batch,
+                       const TransferMatching& matching, BatchMatches& matches)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT p.transaction_id, t.source, t.destination"
+                                             " FROM postings p INDEXED BY postings_amount"
+                                             " JOIN transactions t ON t.id = p.transaction_id"
+                                             " WHERE p.account_id = ? AND p.amount = ? AND p.date BETWEEN ? AND ?"
+                                             " AND p.security = 0"
+                                             " ORDER BY abs(p.date - ?), p.transaction_id"_s);
+    // Ledger transactions matched by earlier rows
+    std::unordered_set<qint64> matched_ids;
+    for(size_t row = 0; row < batch.size(); ++row) {
+        const auto& transaction = batch[row];
+        bool outgoing = is_outgoing(transaction, matching);
+        if(matches.is_removed(row) || (!outgoing && !is_incoming(transaction, matching))) {
+            continue;
+        }
+        // The other side moves money the opposite way, so its posting in the Uncategorized
+        // account has the same sign as this one's
+        query.addBindValue(outgoing ? matching.uncategorized_income_id : matching.uncategorized_expense_id);
+        query.addBindValue(outgoing ? -transaction.amount : transaction.amount);
+        query.addBindValue(transaction.date - matching.window_days);
+        query.addBindValue(transaction.date + matching.window_days);
+        query.addBindValue(transaction.date);
+        sql_helpers::exec(query);
+        while(query.next()) {
+            auto transaction_id = query.value(0).toLongLong();
+            auto other_account = outgoing ? query.value(2).toInt() : query.value(1).toInt();
+            auto account = outgoing ? transaction.source : transaction.destination;
+            if(matched_ids.contains(transaction_id) || other_account == account
+               || other_account == matching.uncategorized_income_id || other_account == matching.uncategorized_expense_id) {
+                continue;
+            }
+            matched_ids.insert(transaction_id);
+            matches.existing_ids[row] = transaction_id;
+            ++matches.removed_count;
+            if(outgoing) {
+                matches.source_changes.emplace_back(transaction_id, account);
+            } else {
+                matches.destination_changes.emplace_back(transaction_id, account);
+            }
+            break;
+        }
+        query.finish();
+    }
+}
+
+static
+void write_batch(const QSqlDatabase& db, const std::vector<ImportedTransaction>& batch, const BatchMatches& matches)
+{
+    // IDs are picked up front (the same ones SQLite would pick) so that the amounts can be
+    // inserted in bulk too
+    auto& max_id_query = sql_helpers::prepared(db, u"SELECT coalesce(max(id), 0) FROM transactions"_s);
+    sql_helpers::exec(max_id_query);
+    sql_helpers::next(max_id_query);
+    auto next_id = max_id_query.value(0).toLongLong() + 1;
+    max_id_query.finish();
+    std::vector<size_t> kept_rows;
+    std::vector<qint64> transaction_ids(batch.size(), 0);
+    kept_rows.reserve(batch.size() - matches.removed_count);
+    for(size_t row = 0; row < batch.size(); ++row) {
+        if(!matches.is_removed(row)) {
+            kept_rows.push_back(row);
+            transaction_ids[row] = next_id++;
+        }
+    }
+
+    sql_helpers::exec_batched(db, kept_rows.size(), 5, [](size_t count) {
+        return u"INSERT INTO transactions(id, date, description, source, destination) VALUES %1"_s
+               .arg(sql_helpers::values_placeholders(count, 5));
+    }, [&](QSqlQuery& query, size_t i) {
+        const auto& row = batch[kept_rows[i]];
+        query.addBindValue(transaction_ids[kept_rows[i]]);
+        query.addBindValue(row.date);
+        query.addBindValue(row.description);
+        query.addBindValue(row.source);
+        query.addBindValue(row.destination);
+    });
+    sql_helpers::exec_batched(db, kept_rows.size(), 2, [](size_t count) {
+        return u"INSERT INTO cash_transactions(transaction_id, amount) VALUES %1"_s
+               .arg(sql_helpers::values_placeholders(count, 2));
+    }, [&](QSqlQuery& query, size_t i) {
+        query.addBindValue(transaction_ids[kept_rows[i]]);
+        query.addBindValue(batch[kept_rows[i]].amount);
+    });
+    auto update = [&db](const std::vector<std::pair<qint64, int>>& changes, QString column) {
+        sql_helpers::exec_batched(db, changes.size(), 2, [&column](size_t count) {
+            return u"UPDATE transactions SET %1 = c.column2 FROM (VALUES %2) AS c WHERE transactions.id = c.column1"_s
+                   .arg(column, sql_helpers::values_placeholders(count, 2));
+        }, [&changes](QSqlQuery& query, size_t i) {
+            query.addBindValue(changes[i].first);
+            query.addBindValue(changes[i].second);
+        });
+    };
+    update(matches.source_changes, u"source"_s);
+    update(matches.destination_changes, u"destination"_s);
+
+    // The import keys of merged rows point to the transaction they were merged into
+    std::vector<size_t> keyed_rows;
+    for(size_t row = 0; row < batch.size(); ++row) {
+        if(!batch[row].import_key.isEmpty()) {
+            keyed_rows.push_back(row);
+        }
+    }
+    auto final_transaction_id = [&](size_t row) {
+        if(matches.merged_into[row] != BatchMatches::not_merged) {
+            row = matches.merged_into[row];
+        }
+        return matches.existing_ids[row] != 0 ? matches.existing_ids[row] : transaction_ids[row];
+    };
+    sql_helpers::exec_batched(db, keyed_rows.size(), 3, [](size_t count) {
+        return u"INSERT INTO imported_transactions(account_id, import_key, transaction_id) VALUES %1"_s
+               .arg(sql_helpers::values_placeholders(count, 3));
+    }, [&](QSqlQuery& query, size_t i) {
+        const auto& row = batch[keyed_rows[i]];
+        query.addBindValue(row.import_account);
+        query.addBindValue(row.import_key);
+        query.addBindValue(final_transaction_id(keyed_rows[i]));
+    });
+}
+
+LedgerWriter::LedgerWriter(const QSqlDatabase& db, size_t batch_size, CommitMode commit_mode)
+    : m_impl(new Impl{.db = db, .batch_size = std::max(batch_size, size_t{1}), .commit_mode = commit_mode})
+{
+    m_impl->batch.reserve(m_impl->batch_size);
+}
+
+LedgerWriter::~LedgerWriter() noexcept
+{
+    delete m_impl;
+}
+
+void LedgerWriter::match_transfers(TransferMatching matching)
+{
+    m_impl->transfer_matching = matching;
+}
+
+void LedgerWriter::add(ImportedTransaction transaction)
+{
+    m_impl->batch.push_back(std::move(transaction));
+    if(m_impl->batch.size() >= m_impl->batch_size) {
+        flush();
+    }
+}
+
+void LedgerWriter::flush()
+{
+    auto& batch = m_impl->batch;
+    if(batch.empty()) {
+        return;
+    }
+    size_t duplicate_count = 0;
+    std::optional<BatchMatches> matches;
+    try {
+        if(!m_impl->transaction) {
+            m_impl->transaction.emplace(m_impl->db);
+        }
+        duplicate_count = remove_imported(m_impl->db, batch);
+        matches.emplace(batch.size());
+        if(const auto& matching = m_impl->transfer_matching) {
+            match_within_batch(batch, *matching, *matches);
+            match_with_ledger(m_impl->db, batch, *matching, *matches);
+        }
+        write_batch(m_impl->db, batch, *matches);
+    } catch(...) {
+        m_impl->roll_back();
+        throw;
+    }
+    m_impl->counts.written += static_cast<qint64>(batch.size());
+    m_impl->counts.transfers += static_cast<qint64>(matches->removed_count);
+    m_impl->counts.duplicates += static_cast<qint64>(duplicate_count);
+    batch.clear();
+    if(m_impl->commit_mode == CommitMode::EachBatch) {
+        commit();
+    }
+}
+
+void LedgerWriter::commit()
+{
+    flush();
+    if(!m_impl->transaction) {
+        return;
+    }
+    try {
+        m_impl->transaction->commit();
+    } catch(...) {
+        m_impl->roll_back();
+        throw;
+    }
+    m_impl->transaction.reset();
+    m_impl->committed_counts = m_impl->counts;
+}
+
+qint64 LedgerWriter::written_count() const
+{
+    return m_impl->counts.written;
+}
+
+qint64 LedgerWriter::transfer_count() const
+{
+    return m_impl->counts.transfers;
+}
+
+qint64 LedgerWriter::duplicate_count() const
+{
+    return m_impl->counts.duplicates;
+}
+
+int find_or_create_account(const QSqlDatabase& db, const QString& path, AccountKind kind)
+{
+    auto& find_query = sql_helpers::prepared(db, u"SELECT id FROM accounts WHERE name = ?"_s);
+    find_query.addBindValue(path);
+    sql_helpers::exec(find_query);
+    if(find_query.next()) {
+        auto account_id = find_query.value(0).toInt();
+        find_query.finish();
+        return account_id;
+    }
+    find_query.finish();
+    auto& insert_query = sql_helpers::prepared(db, u"INSERT INTO accounts(name, kind) VALUES (?, ?) RETURNING id"_s);
+    insert_query.addBindValue(path);
+    insert_query.addBindValue(static_cast<int>(kind));
+    sql_helpers::exec(insert_query);
+    sql_helpers::next(insert_query);
+    auto account_id = insert_query.value(0).toInt();
+    insert_query.finish();
+    return account_id;
+}
@@ -0,0 +1,98 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <QSqlDatabase>
+#include <QString>
+#include "models/SQLColumns.hpp"
+
+// A cash transaction read from an imported file
+struct ImportedTransaction {
+    qint64 date; // Julian day
+    QString description;
+    int source;
+    int destination;
+    qint64 amount; // in cents
+    // The account whose statement the transaction came from and its ID in that statement. If
+    // import_key isn't empty, the pair is recorded in imported_transactions, and a transaction
+    // whose pair was already recorded is skipped instead of being imported again
+    int import_account = 0;
+    QString import_key;
+};
+
+/* An imported transaction between an account and one of the Uncategorized accounts could be one
+   side of a transfer whose other side is imported (or was imported earlier) from another account's
+   statement, e.g. money leaving checking and money arriving in savings. Two such transactions with
+   the same amount, in opposite directions, and at most window_days apart are merged into one */
+struct TransferMatching {
+    int uncategorized_income_id;
+    int uncategorized_expense_id;
+    int window_days = 3;
+};
+
+/* Writes imported transactions to the ledger in large batches. Each batch is inserted with
+   multi-row statements (prepared once and then reused), so however many transactions are
+   imported, only one batch of them is held in memory. Must only be used on the thread that owns
+   the connection */
+class LedgerWriter {
+public:
+    enum class CommitMode {
+        // Each batch is committed as soon as it is written
+        EachBatch,
+        // Everything is written in one transaction, which is committed by commit()
+        AtEnd
+    };
+    static constexpr size_t default_batch_size = 20000;
+
+    explicit
+    LedgerWriter(const QSqlDatabase&, size_t batch_size = default_batch_size, CommitMode = CommitMode::EachBatch);
+    // Transactions that haven't been committed are dropped
+    ~LedgerWriter() noexcept;
+    LedgerWriter(const LedgerWriter&) = delete;
+    LedgerWriter& operator=(const LedgerWriter&) = delete;
+
+    // Before a batch is written, its transactions are matched up with each other and with the
+    // transactions already in the ledger. Transactions are matched up by amount using a hash table
+    // (within the batch) or the postings_amount index (with the ledger)
+    void match_transfers(TransferMatching);
+
+    // Writes out the current batch first if it is full. Throws sql_helpers::Error, in which case
+    // everything not yet committed is dropped
+    void add(ImportedTransaction);
+    // Writes the current batch (committing it if the mode is EachBatch). Throws sql_helpers::Error
+    void flush();
+    // Writes the current batch and commits everything written. Throws sql_helpers::Error
+    void commit();
+    // Number of transactions written so far, not counting any that were rolled back
+    qint64 written_count() const;
+    // Number of the written transactions that were merged into the other side of a transfer
+    // instead of being added as a transaction of their own
+    qint64 transfer_count() const;
+    // Number of transactions skipped because their import key had already been imported (by this
+    // writer or anything else), not counting any that were rolled back
+    qint64 duplicate_count() const;
+private:
+    struct Impl;
+    Impl* m_impl;
+};
+
+// Returns the ID of the account with the given path, creating it (as an account of the given
+// kind, which can't be ACCOUNT_KIND_STOCK) if there isn't one. Throws sql_helpers::Error
+int find_or_create_account(const QSqlDatabase&, const QString& path, AccountKind);
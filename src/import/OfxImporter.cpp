@@ -0,0 +1,306 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "OfxImporter.hpp"
+#include <cmath>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFuture>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTimeZone>
+#include <libofx/libofx.h>
+#include "Categoriser.hpp"
+#include "LedgerWriter.hpp"
+#include "util/sql_helpers.hpp"
+#include "util/thread_pool.hpp"
+
+using namespace Qt::StringLiterals;
+
+using OFXContextOwnerPtr = std::unique_ptr<void, int(*)(void*)>;
+
+// A transaction read from an OFX file, before it is matched up with ledger accounts
+struct OfxRow {
+    QString ofx_account_id;
+    QString account_name;
+    bool is_liability;
+    qint64 date; // Julian day
+    QString description;
+    qint64 amount; // in cents, positive when money goes into the account
+    QString import_key;
+};
+
+using RowHandler = std::function<void(OfxRow&&)>;
+
+// libofx keeps the state of the file being parsed in globals (and OpenSP, which it parses with,
+// isn't reentrant), so only one file is parsed at a time no matter how many contexts there are
+static std::mutex libofx_mutex;
+
+// The import key is left empty unless the bank gave the transaction an ID (see set_import_key())
+static
+OfxRow to_row(const OfxTransactionData& data)
+{
+    if(!data.account_id_valid || !data.amount_valid || !(data.date_posted_valid || data.date_initiated_valid)) {
+        throw std::runtime_error("Transaction is missing its account, amount, or date");
+    }
+    OfxRow row;
+    row.ofx_account_id = QString::fromUtf8(data.account_id);
+    const auto* account = data.account_ptr;
+    row.account_name = account ? QString::fromUtf8(account->account_name) : row.ofx_account_id;
+    row.is_liability = account && account->account_type_valid
+        && (account->account_type == OfxAccountData::OFX_CREDITLINE
+            || account->account_type == OfxAccountData::OFX_CREDITCARD);
+    auto date = data.date_posted_valid ? data.date_posted : data.date_initiated;
+    // Converting to the local time zone could move it to the day before or after the one in the file
+    row.date = QDateTime::fromSecsSinceEpoch(date, QTimeZone::UTC).date().toJulianDay();
+    if(data.name_valid) {
+        row.description = QString::fromUtf8(data.name);
+    } else if(data.memo_valid) {
+        row.description = QString::fromUtf8(data.memo);
+    }
+    row.amount = std::llround(data.amount * 100);
+    if(data.fi_id_valid && data.fi_id[0] != '\0') {
+        row.import_key = QString::fromUtf8(data.fi_id);
+    }
+    return row;
+}
+
+// Hashes the row's contents into its import key if the bank didn't give it an ID. content_counts
+// is how many transactions with each content hash came before this one in the file
+static
+void set_import_key(OfxRow& row, QHash<QByteArray, int>& content_counts)
+{
+    if(!row.import_key.isEmpty()) {
+        return;
+    }
+    // Identical transactions in one statement (e.g. two coffees on the same day) are told apart
+    // by how many came before them
+    auto content = u"%1|%2|%3"_s.arg(row.date).arg(row.amount).arg(row.description).toUtf8();
+    auto hash = QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex();
+    auto occurrence = content_counts[hash]++;
+    row.import_key = u"#%1-%2"_s.arg(QString::fromLatin1(hash)).arg(occurrence);
+}
+
+// Calls on_row for each transaction in the file, in order, before set_import_key(). Throws
+// std::runtime_error if the file can't be parsed, or whatever on_row throws. Holds libofx_mutex
+// the whole time, so on_row should be quick
+static
+void parse_ofx_file(const QString& path, const RowHandler& on_row)
+{
+    struct ParseState {
+        const RowHandler& on_row;
+        // The first error thrown inside a callback. Callbacks after it do nothing
+        std::exception_ptr error;
+    } state{on_row, nullptr};
+
+    std::scoped_lock lock{libofx_mutex};
+    OFXContextOwnerPtr ctx{libofx_get_new_context(), libofx_free_context};
+    ofx_set_transaction_cb(ctx.get(), [](const OfxTransactionData data, void* state_ptr) {
+        auto& state = *static_cast<ParseState*>(state_ptr);
+        if(state.error) {
+            return 0;
+        }
+        try {
+            state.on_row(to_row(data));
+        } catch(...) {
+            state.error = std::current_exception();
+        }
+        return 0;
+    }, &state);
+    if(libofx_proc_file(ctx.get(), QFile::encodeName(path).constData(), LibofxFileFormat::AUTODETECT)) {
+        throw std::runtime_error("Failed to process OFX file");
+    }
+    if(state.error) {
+        std::rethrow_exception(state.error);
+    }
+}
+
+struct OfxImporter::Impl {
+    OfxImporter* importer;
+    QSqlDatabase db;
+    // Only set while importing
+    std::optional<LedgerWriter> writer;
+    // Ledger account IDs, keyed by OFX account ID
+    QHash<QString, int> account_ids;
+    // Only set while importing
+    std::optional<Categoriser> categoriser;
+
+    void start_import();
+    int ledger_account(const OfxRow&);
+    // Transactions that were already imported are skipped by the writer (see LedgerWriter)
+    void write_row(OfxRow&&);
+    void flush();
+};
+
+void OfxImporter::Impl::start_import()
+{
+    categoriser.emplace(db);
+    writer.emplace(db);
+    writer->match_transfers(categoriser->transfer_matching());
+}
+
+int OfxImporter::Impl::ledger_account(const OfxRow& row)
+{
+    if(auto it = account_ids.constFind(row.ofx_account_id); it != account_ids.cend()) {
+        return *it;
+    }
+    auto& find_query = sql_helpers::prepared(db, u"SELECT account_id FROM ofx_accounts WHERE ofx_account_id = ?"_s);
+    find_query.addBindValue(row.ofx_account_id);
+    sql_helpers::exec(find_query);
+    if(find_query.next()) {
+        auto account_id = find_query.value(0).toInt();
+        find_query.finish();
+        account_ids.insert(row.ofx_account_id, account_id);
+        return account_id;
+    }
+    find_query.finish();
+
+    auto name = row.account_name;
+    // ':' separates the levels of an account's path
+    name.replace(':', '-');
+    sql_helpers::Transaction transaction{db};
+    auto account_id = find_or_create_account(
+        db, (row.is_liability ? u"Liabilities:"_s : u"Assets:"_s) + name, ACCOUNT_KIND_BANK);
+    auto& insert_query = sql_helpers::prepared(db, u"INSERT INTO ofx_accounts VALUES (?, ?)"_s);
+    insert_query.addBindValue(row.ofx_account_id);
+    insert_query.addBindValue(account_id);
+    sql_helpers::exec(insert_query);
+    insert_query.finish();
+    transaction.commit();
+    account_ids.insert(row.ofx_account_id, account_id);
+    return account_id;
+}
+
+void OfxImporter::Impl::write_row(OfxRow&& row)
+{
+    auto account_id = ledger_account(row);
+    auto transaction = categoriser->categorise(row.date, std::move(row.description), account_id, row.amount);
+    transaction.import_account = account_id;
+    transaction.import_key = std::move(row.import_key);
+    auto written_before = writer->written_count();
+    writer->add(std::move(transaction));
+    if(writer->written_count() != written_before) {
+        emit importer->progress(writer->written_count());
+    }
+}
+
+void OfxImporter::Impl::flush()
+{
+    auto written_before = writer->written_count();
+    writer->flush();
+    if(writer->written_count() != written_before) {
+        emit importer->progress(writer->written_count());
+    }
+}
+
+// Ends an import, dropping anything the writer didn't get to write
+struct WriterReset {
+    std::optional<LedgerWriter>& writer;
+
+    ~WriterReset() noexcept
+    {
+        writer.reset();
+    }
+};
+
+OfxImporter::OfxImporter(const QSqlDatabase& db)
+    : m_impl(new Impl{.importer = this, .db = db})
+{}
+
+OfxImporter::~OfxImporter() noexcept
+{
+    delete m_impl;
+}
+
+qint64 OfxImporter::import_file(const QString& path)
+{
+    m_impl->start_import();
+    WriterReset writer_reset{m_impl->writer};
+
+    // Written as it is parsed. Nothing else can parse in the meantime, but an import_file() call
+    // has only the one file
+    QHash<QByteArray, int> content_counts;
+    parse_ofx_file(path, [&](OfxRow&& row) {
+        set_import_key(row, content_counts);
+        m_impl->write_row(std::move(row));
+    });
+    m_impl->flush();
+    return m_impl->writer->written_count();
+}
+
+OfxBatchResult OfxImporter::import_directory(const QString& dir_path)
+{
+    QDir dir{dir_path};
+    auto file_names = dir.entryList({u"*.ofx"_s, u"*.qfx"_s}, QDir::Files, QDir::Name);
+    m_impl->start_import();
+    WriterReset writer_reset{m_impl->writer};
+
+    // Only a few files are parsed ahead of the one being written, so memory use doesn't grow with
+    // the number of files. libofx parses one of them at a time, and the rest of the work on their
+    // rows happens in parallel
+    auto max_parsing = thread_pool::max_tasks_ahead();
+    std::deque<QFuture<std::vector<OfxRow>>> parsing;
+    qsizetype next_file = 0;
+    auto parse_more = [&] {
+        while(next_file < file_names.size() && parsing.size() < max_parsing) {
+            parsing.push_back(thread_pool::run([path = dir.filePath(file_names[next_file++])] {
+                std::vector<OfxRow> rows;
+                parse_ofx_file(path, [&rows](OfxRow&& row) { rows.push_back(std::move(row)); });
+                QHash<QByteArray, int> content_counts;
+                for(auto& row : rows) {
+                    set_import_key(row, content_counts);
+                }
+                return rows;
+            }));
+        }
+    };
+    parse_more();
+
+    OfxBatchResult result;
+    for(const auto& file_name : file_names) {
+        auto future = std::move(parsing.front());
+        parsing.pop_front();
+        parse_more();
+        std::vector<OfxRow> rows;
+        try {
+            rows = future.takeResult();
+        } catch(const std::exception& err) {
+            result.failed_files.append(u"%1: %2"_s.arg(file_name, QString::fromUtf8(err.what())));
+            continue;
+        }
+        for(auto& row : rows) {
+            m_impl->write_row(std::move(row));
+        }
+    }
+    m_impl->flush();
+    result.imported_count = m_impl->writer->written_count();
+    result.transfer_count = m_impl->writer->transfer_count();
+    result.duplicate_count = m_impl->writer->duplicate_count();
+    return result;
+}
@@ -0,0 +1,70 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QSqlDatabase;
+QT_END_NAMESPACE
+
+struct OfxBatchResult {
+    qint64 imported_count = 0;
+    // Transactions skipped because they had already been imported
+    qint64 duplicate_count = 0;
+    // Imported transactions that became the other side of a transfer (see TransferMatching)
+    // instead of a transaction of their own
+    qint64 transfer_count = 0;
+    // One "file name: error" entry for each file that couldn't be parsed
+    QStringList failed_files;
+};
+
+/* Imports the transactions in OFX files into the ledger. Each OFX account is mapped to a ledger
+   account (see the ofx_accounts table), creating one under Assets or Liabilities the first time it
+   is seen. The other side of each transaction is picked by a Categoriser, or if it's a transfer
+   between accounts, matched up with the other side (see TransferMatching). Transactions that were already imported (see
+   the imported_transactions table) are skipped, so importing overlapping statements is safe.
+   Transactions are written in batches (see LedgerWriter). Must only be used on the thread that
+   owns the connection */
+class OfxImporter : public QObject {
+    Q_OBJECT
+public:
+    explicit
+    OfxImporter(const QSqlDatabase&);
+    ~OfxImporter() noexcept;
+
+    // Returns the number of transactions imported. The file is written as it is parsed, so memory
+    // use doesn't grow with its size. Throws sql_helpers::Error if writing to the database fails
+    // or std::runtime_error if the file can't be parsed. Batches committed before the error stay
+    // imported
+    qint64 import_file(const QString& path);
+    // Imports every .ofx and .qfx file in a directory, in order of file name. The files are
+    // parsed on the global thread pool while earlier ones are being written (libofx can only
+    // parse one file at a time, but their rows are hashed in parallel). A file that can't be
+    // parsed is skipped entirely. Throws sql_helpers::Error
+    OfxBatchResult import_directory(const QString& dir_path);
+signals:
+    // Emitted after each batch is committed, with the total imported so far by the current call
+    void progress(qint64 imported_count);
+private:
+    struct Impl;
+    Impl* m_impl;
+};
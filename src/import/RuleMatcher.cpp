@@ -0,0 +1,129 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "RuleMatcher.hpp"
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <QSqlQuery>
+#include "util/sql_helpers.hpp"
+
+using namespace Qt::StringLiterals;
+
+static constexpr qint32 no_rule = std::numeric_limits<qint32>::max();
+
+static
+char16_t fold_case(QChar c)
+{
+    return static_cast<char16_t>(QChar::toCaseFolded(c.unicode()));
+}
+
+RuleMatcher::RuleMatcher()
+    : RuleMatcher(std::vector<Rule>{})
+{}
+
+RuleMatcher::RuleMatcher(std::vector<Rule> rules)
+    : m_char_classes(0x10000, 0)
+{
+    std::erase_if(rules, [](const Rule& rule) { return rule.pattern.isEmpty(); });
+    std::stable_sort(rules.begin(), rules.end(), [](const Rule& a, const Rule& b) {
+        return a.pattern.size() > b.pattern.size();
+    });
+    for(auto& rule : rules) {
+        for(auto& c : rule.pattern) {
+            c = fold_case(c);
+            if(m_char_classes[c.unicode()] == 0) {
+                m_char_classes[c.unicode()] = static_cast<quint16>(m_class_count++);
+            }
+        }
+    }
+    const auto class_count = static_cast<size_t>(m_class_count);
+
+    // Build a trie of the patterns, with -1 marking missing transitions
+    m_transitions.assign(class_count, -1);
+    m_state_rules.assign(1, no_rule);
+    for(size_t rule = 0; rule < rules.size(); ++rule) {
+        qint32 state = 0;
+        for(QChar c : rules[rule].pattern) {
+            auto index = state * class_count + m_char_classes[c.unicode()];
+            if(m_transitions[index] < 0) {
+                m_transitions[index] = static_cast<qint32>(m_state_rules.size());
+                m_state_rules.push_back(no_rule);
+                m_transitions.resize(m_transitions.size() + class_count, -1);
+            }
+            state = m_transitions[index];
+        }
+        m_state_rules[state] = std::min(m_state_rules[state], static_cast<qint32>(rule));
+        m_account_ids.push_back(rules[rule].account_id);
+    }
+
+    // Fill in the missing transitions from each state's failure state (the state for the longest
+    // proper suffix of the text that leads to it). States are visited breadth first, so a state's
+    // failure state is always finished before it
+    std::vector<qint32> failures(m_state_rules.size(), 0);
+    std::vector<qint32> queue;
+    queue.reserve(m_state_rules.size());
+    for(size_t char_class = 0; char_class < class_count; ++char_class) {
+        auto& next = m_transitions[char_class];
+        if(next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for(size_t i = 0; i < queue.size(); ++i) {
+        auto state = queue[i];
+        auto failure = failures[state];
+        // Any pattern that ends at the failure state also ends here
+        m_state_rules[state] = std::min(m_state_rules[state], m_state_rules[failure]);
+        for(size_t char_class = 0; char_class < class_count; ++char_class) {
+            auto& next = m_transitions[state * class_count + char_class];
+            auto failure_next = m_transitions[failure * class_count + char_class];
+            if(next < 0) {
+                next = failure_next;
+            } else {
+                failures[next] = failure_next;
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+RuleMatcher RuleMatcher::load(const QSqlDatabase& db)
+{
+    QSqlQuery query{db};
+    query.setForwardOnly(true);
+    sql_helpers::exec(query, u"SELECT pattern, account_id FROM categorisation_rules ORDER BY id"_s);
+    std::vector<Rule> rules;
+    while(query.next()) {
+        rules.push_back(Rule{query.value(0).toString(), query.value(1).toInt()});
+    }
+    return RuleMatcher(std::move(rules));
+}
+
+int RuleMatcher::match(QStringView description) const
+{
+    const auto class_count = static_cast<size_t>(m_class_count);
+    qint32 state = 0;
+    auto best_rule = no_rule;
+    for(QChar c : description) {
+        state = m_transitions[state * class_count + m_char_classes[fold_case(c)]];
+        best_rule = std::min(best_rule, m_state_rules[state]);
+    }
+    return best_rule == no_rule ? 0 : m_account_ids[best_rule];
+}
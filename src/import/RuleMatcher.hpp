@@ -0,0 +1,63 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <QString>
+#include <QStringView>
+
+QT_BEGIN_NAMESPACE
+class QSqlDatabase;
+QT_END_NAMESPACE
+
+/* Finds which categorisation rule matches a description, i.e. the rule with the longest pattern
+   that occurs in it (ignoring case), with ties going to the rule listed first. All the patterns
+   are compiled into one Aho-Corasick automaton with a full transition table, so a description is
+   matched in a single pass no matter how many rules there are. Matching doesn't modify the
+   matcher, so one matcher can be shared by several threads */
+class RuleMatcher {
+public:
+    struct Rule {
+        QString pattern;
+        int account_id;
+    };
+
+    // A matcher with no rules
+    RuleMatcher();
+    explicit
+    RuleMatcher(std::vector<Rule>);
+    // Loads the rules in the categorisation_rules table. Throws sql_helpers::Error
+    static
+    RuleMatcher load(const QSqlDatabase&);
+
+    // Returns the account of the matching rule, or 0 if no rule matches
+    int match(QStringView description) const;
+    bool empty() const { return m_account_ids.empty(); }
+private:
+    // The class of each UTF-16 code unit. Those that appear in no pattern all share class 0
+    std::vector<quint16> m_char_classes;
+    int m_class_count = 1;
+    // The state reached from each state by each class of character, indexed by
+    // state * m_class_count + class
+    std::vector<qint32> m_transitions;
+    // For each state, the best rule (the lowest index in m_account_ids) whose pattern ends there
+    std::vector<qint32> m_state_rules;
+    // The rules' accounts, best rule first
+    std::vector<int> m_account_ids;
+};
@@ -0,0 +1,170 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "AccountDirectory.hpp"
+#include <algorithm>
+#include <utility>
+#include <QHash>
+#include "Roles.hpp"
+
+struct AccountDirectory::Impl {
+    // Index of the first entry whose name is not less than the given name
+    int lower_bound(const QString& name) const
+    {
+        auto it = std::ranges::lower_bound(entries, name, {}, &Entry::name);
+        return static_cast<int>(it - entries.begin());
+    }
+
+    // Sorted by name
+    std::vector<Entry> entries;
+    QHash<int, QString> names;
+};
+
+AccountDirectory::AccountDirectory()
+    : QAbstractListModel(), m_impl(new Impl)
+{}
+
+AccountDirectory::~AccountDirectory() noexcept
+{
+    delete m_impl;
+}
+
+int AccountDirectory::rowCount(const QModelIndex& parent) const
+{
+    if(parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(m_impl->entries.size());
+}
+
+QVariant AccountDirectory::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid() || index.row() >= rowCount()) {
+        return {};
+    }
+    const auto& entry = m_impl->entries[index.row()];
+    switch(role) {
+        case Qt::DisplayRole:
+            return entry.name;
+        case Account_ID_Role:
+            return entry.id;
+        default:
+            return {};
+    }
+}
+
+QString AccountDirectory::name(int account_id) const
+{
+    return m_impl->names.value(account_id);
+}
+
+int AccountDirectory::row(int account_id) const
+{
+    auto it = m_impl->names.constFind(account_id);
+    if(it == m_impl->names.cend()) {
+        return -1;
+    }
+    // Names are unique, so this finds the account's own entry
+    return m_impl->lower_bound(it.value());
+}
+
+void AccountDirectory::reset(std::vector<Entry> entries)
+{
+    beginResetModel();
+    std::ranges::sort(entries, {}, &Entry::name);
+    m_impl->names.clear();
+    m_impl->names.reserve(static_cast<qsizetype>(entries.size()));
+    for(const auto& entry : entries) {
+        m_impl->names.insert(entry.id, entry.name);
+    }
+    m_impl->entries = std::move(entries);
+    endResetModel();
+}
+
+void AccountDirectory::insert(int account_id, const QString& name)
+{
+    if(m_impl->names.contains(account_id)) {
+        return;
+    }
+    auto row = m_impl->lower_bound(name);
+    beginInsertRows({}, row, row);
+    m_impl->entries.insert(m_impl->entries.begin() + row, {account_id, name});
+    m_impl->names.insert(account_id, name);
+    endInsertRows();
+}
+
+void AccountDirectory::remove(int account_id)
+{
+    auto row = this->row(account_id);
+    if(row < 0) {
+        return;
+    }
+    beginRemoveRows({}, row, row);
+    m_impl->entries.erase(m_impl->entries.begin() + row);
+    m_impl->names.remove(account_id);
+    endRemoveRows();
+}
+
+void AccountDirectory::move_subtree(const QString& old_path, const QString& new_path)
+{
+    // The subtree's entries are contiguous, but the account itself can be separated from them
+    // (e.g. "A:B-2" sorts between "A:B" and "A:B:C"), so the two are moved separately
+    auto own_row = m_impl->lower_bound(old_path);
+    if(own_row < rowCount() && m_impl->entries[own_row].name == old_path) {
+        move_entries(own_row, own_row + 1, old_path, new_path);
+    }
+    move_entries(m_impl->lower_bound(old_path + u':'), m_impl->lower_bound(old_path + u';'), old_path, new_path);
+    emit subtree_moved(old_path, new_path);
+}
+
+void AccountDirectory::move_entries(int first, int last, const QString& old_path, const QString& new_path)
+{
+    if(first == last) {
+        return;
+    }
+    // Renaming keeps the entries in the same order among themselves, and nothing else starts
+    // with new_path, so they stay contiguous and only have to be moved as a block
+    auto& entries = m_impl->entries;
+    auto new_first_name = new_path + QStringView(entries[first].name).mid(old_path.size());
+    auto destination = std::ranges::lower_bound(entries.begin(), entries.begin() + first, new_first_name, {}, &Entry::name)
+                       - entries.begin();
+    if(destination == first) {
+        destination = std::ranges::lower_bound(entries.begin() + last, entries.end(), new_first_name, {}, &Entry::name)
+                      - entries.begin();
+    }
+    bool is_moved = destination < first || destination > last;
+    if(is_moved) {
+        beginMoveRows({}, first, last - 1, {}, static_cast<int>(destination));
+    }
+    for(auto row = first; row < last; ++row) {
+        auto& entry = entries[row];
+        entry.name = new_path + QStringView(entry.name).mid(old_path.size());
+        m_impl->names.insert(entry.id, entry.name);
+    }
+    auto new_first = first;
+    if(destination < first) {
+        std::rotate(entries.begin() + destination, entries.begin() + first, entries.begin() + last);
+        new_first = static_cast<int>(destination);
+    } else if(destination > last) {
+        std::rotate(entries.begin() + first, entries.begin() + last, entries.begin() + destination);
+        new_first = static_cast<int>(destination) - (last - first);
+    }
+    if(is_moved) {
+        endMoveRows();
+    }
+    emit dataChanged(index(new_first), index(new_first + (last - first) - 1));
+}
@@ -0,0 +1,61 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <vector>
+#include <QAbstractListModel>
+#include <QString>
+
+/* Every account's name (its full path), for showing accounts by name and picking them from a
+   list. Lookups by ID are hashed, and the list (this model's rows) is kept sorted by name. One
+   directory is shared by all open views and is kept up to date by AccountTree */
+class AccountDirectory : public QAbstractListModel {
+    Q_OBJECT
+public:
+    struct Entry {
+        int id;
+        QString name;
+    };
+
+    AccountDirectory();
+    ~AccountDirectory() noexcept;
+
+    int rowCount(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex&, int role = Qt::DisplayRole) const override;
+
+    // Name of the account, or an empty string if there is no such account
+    QString name(int account_id) const;
+    // Row of the account in the list, or -1 if there is no such account
+    int row(int account_id) const;
+
+    void reset(std::vector<Entry>);
+    void insert(int account_id, const QString& name);
+    void remove(int account_id);
+    // Renames old_path and every account below it to start with new_path instead
+    void move_subtree(const QString& old_path, const QString& new_path);
+signals:
+    // Emitted after move_subtree(), for things that refer to levels of the hierarchy by path
+    void subtree_moved(const QString& old_path, const QString& new_path);
+private:
+    // Renames the entries in [first, last) (which share the prefix old_path) and moves them to
+    // their place in the sorted order
+    void move_entries(int first, int last, const QString& old_path, const QString& new_path);
+
+    struct Impl;
+    Impl* m_impl;
+};
@@ -17,63 +17,1275 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "AccountTransactions.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 #include <QDate>
+#include <QHash>
+#include <QSqlQuery>
 #include <QString>
+#include <QStringList>
+#include "DatabaseManager.hpp"
+#include "Money.hpp"
+#include "Roles.hpp"
 #include "SQLColumns.hpp"
+#include "util/sql_helpers.hpp"
 
 using namespace Qt::StringLiterals;
 
-AccountTransactions::AccountTransactions(QSqlDatabase& db, int account_id, AccountKind account_kind)
-    : QSqlTableModel(nullptr, db)
-{
-    std::vector<QString> column_names{
-        u"Date"_s,
-        u"Description"_s,
-        u"Source"_s,
-        u"Destination"_s
-    };
-    switch(account_kind) {
-        case ACCOUNT_KIND_BANK:
-        case ACCOUNT_KIND_INCOME:
-        case ACCOUNT_KIND_EXPENSE:
-            setTable(u"transactions_as_cash_view"_s);
-            column_names.push_back(u"Amount"_s);
-            break;
-        case ACCOUNT_KIND_STOCK:
-            setTable(u"security_transactions_view"_s);
-            column_names.push_back(u"Unit Price"_s);
-            column_names.push_back(u"Quantity"_s);
-            break;
-        default:
-            throw std::runtime_error("Unexpected account kind used with AccountTransactions model");
+// Number of rows requested from the database each time the view scrolls past the end of the
+// rows fetched so far
+static constexpr int page_size = 256;
+// Once more than this many pages are in memory, the least recently used ones are dropped. They
+// are fetched again (by their key range) if they are scrolled back into view
+static constexpr size_t max_resident_pages = 16;
+
+namespace {
+
+// Unsubmitted rows (and fetched rows with unsubmitted edits). Values are in the form returned
+// by AccountTransactions::data()
+using Row = std::vector<QVariant>;
+
+// Position of a row in the (date, id) order that transactions are shown in
+struct RowKey {
+    qint64 date; // Julian day
+    qint64 id;
+
+    friend auto operator<=>(const RowKey&, const RowKey&) = default;
+};
+
+// What the worker thread sends back after submitting changes
+struct SubmitResult {
+    // IDs given to the inserted rows, in order, start from this one
+    qint64 first_inserted_id = 0;
+    // The updated and inserted rows as stored (in the form selected by Impl::select_text),
+    // except for any that no longer involve the account
+    std::vector<Row> stored_rows;
+};
+
+// Interns descriptions so that rows with the same description share one string
+class StringPool {
+public:
+    quint32 intern(const QString& string)
+    {
+        auto it = m_handles.constFind(string);
+        if(it != m_handles.cend()) {
+            return it.value();
+        }
+        auto handle = static_cast<quint32>(m_strings.size());
+        m_strings.push_back(string);
+        m_handles.insert(string, handle);
+        return handle;
+    }
+
+    const QString& get(quint32 handle) const { return m_strings[handle]; }
+    size_t size() const { return m_strings.size(); }
+private:
+    std::vector<QString> m_strings;
+    QHash<QString, quint32> m_handles;
+};
+
+/* A run of consecutive rows, stored column by column. Dates are kept as Julian days, the same
+   way that the database stores them. When a page is evicted, the keys and balance
+   changes of its rows (24 bytes per row) are kept, so that rows can still be found, added, and
+   removed, and the running balance carried past it, without fetching it again */
+struct Page {
+    void evict()
+    {
+        descriptions = {};
+        sources = {};
+        destinations = {};
+        for(auto& column : amount_columns) {
+            column = {};
+        }
+        balances = {};
+        resident = false;
+    }
+
+    void clear()
+    {
+        evict();
+        ids = {};
+        dates = {};
+        changes = {};
+    }
+
+    size_t size() const { return ids.size(); }
+    RowKey key(size_t offset) const { return {dates[offset], ids[offset]}; }
+
+    // Offset of the first row whose key is not less than the given key
+    size_t lower_bound(RowKey key) const
+    {
+        size_t low = 0;
+        size_t high = size();
+        while(low < high) {
+            auto mid = low + (high - low) / 2;
+            if(this->key(mid) < key) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    void compute_balances()
+    {
+        if(!resident) {
+            closing_balance = std::accumulate(changes.begin(), changes.end(), opening_balance);
+            return;
+        }
+        balances.resize(changes.size());
+        auto balance = opening_balance;
+        for(size_t i = 0; i < changes.size(); ++i) {
+            balance += changes[i];
+            balances[i] = balance;
+        }
+        closing_balance = balance;
     }
-    int column_num = TRANSACTIONS_VIEW_DATE;
-    for(const auto& name : column_names) {
-        setHeaderData(column_num++, Qt::Horizontal, name);
+
+    void erase(size_t offset)
+    {
+        ids.erase(ids.begin() + offset);
+        dates.erase(dates.begin() + offset);
+        changes.erase(changes.begin() + offset);
+        if(resident) {
+            descriptions.erase(descriptions.begin() + offset);
+            sources.erase(sources.begin() + offset);
+            destinations.erase(destinations.begin() + offset);
+            for(auto& column : amount_columns) {
+                column.erase(column.begin() + offset);
+            }
+            balances.erase(balances.begin() + offset);
+        }
+        --row_count;
     }
 
-    setFilter(u"source = %1 or destination = %1"_s.arg(account_id));
-    // Note: can't use OnItemChange because that causes the foreign keys to be exposed
-    //  when editing (instead of the human-readable names those keys are mapped to)
-    setEditStrategy(EditStrategy::OnManualSubmit);
-    setSort(TRANSACTIONS_VIEW_DATE, Qt::SortOrder::AscendingOrder);
+    RowKey first_key;
+    RowKey last_key;
+    int row_count = 0;
+    bool resident = false;
+    unsigned int last_used = 0;
+    // Balance of the account (in cents) before the first row and after the last row. These
+    // checkpoints are kept when the page is evicted so that the running balance can be
+    // recomputed from them without re-reading any earlier pages
+    qint64 opening_balance = 0;
+    qint64 closing_balance = 0;
 
-    select();
+    std::vector<qint64> ids;
+    std::vector<qint64> dates;
+    std::vector<quint32> descriptions; // Handles into Impl::descriptions
+    std::vector<int> sources;
+    std::vector<int> destinations;
+    // The Amount column for cash accounts, or the Unit Price and Quantity columns for
+    // stock accounts, as fixed-point units (see Money.hpp)
+    std::vector<std::vector<qint64>> amount_columns;
+    // How much each row adds to the balance of the account, in cents
+    std::vector<qint64> changes;
+    // Balance of the account after each row
+    std::vector<qint64> balances;
+};
+
+} // namespace
+
+// Binds the columns of a row that are stored in the transactions table (other than the ID)
+static
+void bind_transaction_columns(QSqlQuery& query, const Row& row)
+{
+    auto date = row[TRANSACTIONS_VIEW_DATE].toDate();
+    query.addBindValue(date.isValid() ? QVariant(date.toJulianDay()) : QVariant(QMetaType::fromType<qint64>()));
+    query.addBindValue(row[TRANSACTIONS_VIEW_DESCRIPTION]);
+    query.addBindValue(row[TRANSACTIONS_VIEW_SOURCE]);
+    query.addBindValue(row[TRANSACTIONS_VIEW_DESTINATION]);
 }
 
-QVariant AccountTransactions::data(const QModelIndex& index, int role) const
+// Runs on the database worker thread. Reads the given transactions (in the form selected by
+// select_text), skipping any that don't involve the account
+static
+std::vector<Row> read_stored_rows(QSqlDatabase& db, const QString& select_text, int account_id, int column_count,
+                                  const std::vector<qint64>& ids)
 {
-    auto data = QSqlTableModel::data(index, role);
-    if(role == Qt::DisplayRole || role == Qt::EditRole) {
-        switch(index.column()) {
-            case TRANSACTIONS_VIEW_DATE:
-                data = QDate::fromString(data.toString(), Qt::ISODate);
+    std::vector<Row> stored_rows;
+    sql_helpers::exec_batched(db, ids.size(), 1, [&](size_t count) {
+        return u"%1 WHERE p.account_id = %2 AND p.transaction_id IN (%3)"_s
+               .arg(select_text).arg(account_id)
+               .arg(QStringList(static_cast<qsizetype>(count), u"?"_s).join(u", "));
+    }, [&](QSqlQuery& query, size_t i) {
+        query.addBindValue(ids[i]);
+    }, [&](QSqlQuery& query) {
+        while(query.next()) {
+            Row stored_row(column_count);
+            for(int col = 0; col < column_count; ++col) {
+                stored_row[col] = query.value(col);
+            }
+            stored_rows.push_back(std::move(stored_row));
+        }
+    });
+    return stored_rows;
+}
+
+struct AccountTransactions::Impl {
+    Impl(DatabaseManager& db_manager, int account_id, AccountKind account_kind)
+        : db_manager(&db_manager), db(db_manager.database()), account_id(account_id)
+    {
+        column_names = {
+            u"ID"_s,
+            u"Date"_s,
+            u"Description"_s,
+            u"Source"_s,
+            u"Destination"_s
+        };
+        switch(account_kind) {
+            case ACCOUNT_KIND_BANK:
+            case ACCOUNT_KIND_INCOME:
+            case ACCOUNT_KIND_EXPENSE:
+                // The amount is shown as it is stored: positive when money moves from the source
+                // to the destination
+                select_text = u"SELECT t.id, t.date, t.description, t.source, t.destination,"
+                               " iif(t.destination = p.account_id, p.amount, -p.amount), p.amount"
+                               " FROM postings p"
+                               " JOIN transactions t ON t.id = p.transaction_id"_s;
+                // Taken back from the stored balance, so that only the postings from the first
+                // shown day onwards are read
+                opening_balance_text = u"SELECT b.balance - coalesce((SELECT sum(p.amount) FROM postings p"
+                                        " WHERE p.account_id = b.account_id AND p.date >= ?), 0)"
+                                        " FROM account_balances b WHERE b.account_id = ?"_s;
+                amount_table = u"cash_transactions"_s;
+                amount_column_names = {u"amount"_s};
+                column_names.push_back(u"Amount"_s);
+                amount_scales = {Money::scale};
                 break;
-            default:
+            case ACCOUNT_KIND_STOCK:
+                // Only the account's security transactions, read through the partial index over
+                // their postings (which needs the p.security condition to be usable)
+                select_text = u"SELECT t.id, t.date, t.description, t.source, t.destination, st.unit_price, st.quantity, p.amount"
+                               " FROM postings p INDEXED BY postings_security"
+                               " JOIN transactions t ON t.id = p.transaction_id AND p.security = 1"
+                               " JOIN security_transactions st ON st.transaction_id = p.transaction_id"_s;
+                // The stored balance also counts cash movements, so the earlier security
+                // transactions are summed instead
+                opening_balance_text = u"SELECT coalesce(sum(p.amount), 0) FROM postings p INDEXED BY postings_security"
+                                        " WHERE p.security = 1 AND p.date < ? AND p.account_id = ?"_s;
+                amount_table = u"security_transactions"_s;
+                amount_column_names = {u"unit_price"_s, u"quantity"_s};
+                column_names.push_back(u"Unit Price"_s);
+                column_names.push_back(u"Quantity"_s);
+                amount_scales = {Price::scale, Quantity::scale};
                 break;
+            default:
+                throw std::runtime_error("Unexpected account kind used with AccountTransactions model");
+        }
+        column_names.push_back(u"Balance"_s);
+    }
+
+    int column_count() const { return static_cast<int>(column_names.size()); }
+    int amount_column_count() const { return static_cast<int>(amount_scales.size()); }
+    // The running balance comes after the amount columns and is not stored in the database
+    int balance_column() const { return TRANSACTIONS_VIEW_COL_COUNT + amount_column_count(); }
+
+    QString page_query_text(QStringView range_condition) const
+    {
+        // The account's postings are one range of the primary key, already in (date, id) order
+        return u"%1 WHERE p.account_id = ? AND %2"
+                " ORDER BY p.date, p.transaction_id"_s.arg(select_text, range_condition);
+    }
+
+    static
+    RowKey stored_key(const Row& stored_row)
+    {
+        return {stored_row[TRANSACTIONS_VIEW_DATE].toLongLong(), stored_row[TRANSACTIONS_VIEW_ID].toLongLong()};
+    }
+
+    // Inserts a row (in the form selected by select_text, where the last column is the signed
+    // change in the account's balance in cents) into a page. The page's balances are not updated
+    void insert_stored_row(Page& page, size_t offset, const Row& stored_row)
+    {
+        auto key = stored_key(stored_row);
+        page.ids.insert(page.ids.begin() + offset, key.id);
+        page.dates.insert(page.dates.begin() + offset, key.date);
+        page.changes.insert(page.changes.begin() + offset, stored_row[balance_column()].toLongLong());
+        if(!page.resident) {
+            return;
+        }
+        page.descriptions.insert(page.descriptions.begin() + offset,
+                                 descriptions.intern(stored_row[TRANSACTIONS_VIEW_DESCRIPTION].toString()));
+        page.sources.insert(page.sources.begin() + offset, stored_row[TRANSACTIONS_VIEW_SOURCE].toInt());
+        page.destinations.insert(page.destinations.begin() + offset, stored_row[TRANSACTIONS_VIEW_DESTINATION].toInt());
+        page.amount_columns.resize(amount_column_count());
+        for(int i = 0; i < amount_column_count(); ++i) {
+            const auto& value = stored_row[TRANSACTIONS_VIEW_COL_COUNT + i];
+            auto& column = page.amount_columns[i];
+            column.insert(column.begin() + offset, value.toLongLong());
+        }
+        page.balances.insert(page.balances.begin() + offset, 0);
+    }
+
+    // Reads the rows of a page, carrying the running balance forward from page.opening_balance
+    void read_rows(QSqlQuery& query, Page& page)
+    {
+        page.resident = true;
+        Row stored_row(column_count());
+        while(query.next()) {
+            for(int col = 0; col < column_count(); ++col) {
+                stored_row[col] = query.value(col);
+            }
+            insert_stored_row(page, page.size(), stored_row);
         }
+        query.finish();
+        page.compute_balances();
+    }
+
+    bool in_date_range(RowKey key) const
+    {
+        return key.date >= first_day && key.date <= last_day;
+    }
+
+    // Balance of the account before the first day shown
+    qint64 read_opening_balance()
+    {
+        if(first_day == std::numeric_limits<qint64>::min()) {
+            return 0;
+        }
+        auto& query = sql_helpers::prepared(db, opening_balance_text);
+        query.addBindValue(first_day);
+        query.addBindValue(account_id);
+        sql_helpers::exec(query);
+        sql_helpers::next(query);
+        auto balance = query.value(0).toLongLong();
+        query.finish();
+        return balance;
+    }
+
+    // Fetches the next page_size rows after the last fetched row. The end of the date range
+    // bounds the same range scan, so a date range costs only as much as the rows in it
+    Page fetch_next_page()
+    {
+        auto& query = sql_helpers::prepared(db, page_query_text(
+            u"(p.date, p.transaction_id) > (?, ?) AND p.date <= ?") + u" LIMIT ?"_s);
+        // Transaction IDs start from 1, so every row on the first day comes after (first_day, 0)
+        auto after = pages.empty() ? RowKey{first_day, 0} : pages.back().last_key;
+        query.addBindValue(account_id);
+        query.addBindValue(after.date);
+        query.addBindValue(after.id);
+        query.addBindValue(last_day);
+        query.addBindValue(page_size);
+        sql_helpers::exec(query);
+        Page page;
+        page.opening_balance = pages.empty() ? opening_balance : pages.back().closing_balance;
+        read_rows(query, page);
+        page.row_count = static_cast<int>(page.size());
+        if(page.row_count > 0) {
+            page.first_key = {page.dates.front(), page.ids.front()};
+            page.last_key = {page.dates.back(), page.ids.back()};
+        }
+        return page;
+    }
+
+    // Re-fetches the rows of a page that was evicted. If another connection has added or
+    // removed rows in its range since it was first fetched, the page may come back with
+    // fewer or more rows than the view was told about; any extra rows are ignored
+    void load_page(Page& page)
+    {
+        auto& query = sql_helpers::prepared(db, page_query_text(
+            u"(p.date, p.transaction_id) >= (?, ?) AND (p.date, p.transaction_id) <= (?, ?)"));
+        query.addBindValue(account_id);
+        query.addBindValue(page.first_key.date);
+        query.addBindValue(page.first_key.id);
+        query.addBindValue(page.last_key.date);
+        query.addBindValue(page.last_key.id);
+        sql_helpers::exec(query);
+        page.clear();
+        read_rows(query, page);
+    }
+
+    void evict_pages()
+    {
+        if(defer_eviction) {
+            return;
+        }
+        std::vector<Page*> resident_pages;
+        size_t resident_row_count = 0;
+        for(auto& page : pages) {
+            if(page.resident) {
+                resident_pages.push_back(&page);
+                resident_row_count += page.size();
+            }
+        }
+        if(resident_pages.size() > max_resident_pages) {
+            std::ranges::sort(resident_pages, {}, [](const Page* page) { return page->last_used; });
+            auto evict_count = resident_pages.size() - max_resident_pages;
+            for(size_t i = 0; i < evict_count; ++i) {
+                resident_row_count -= resident_pages[i]->size();
+                resident_pages[i]->evict();
+            }
+            resident_pages.erase(resident_pages.begin(), resident_pages.begin() + evict_count);
+        }
+        // Descriptions of evicted rows stay in the pool until it is rebuilt from the resident rows
+        if(descriptions.size() > 2 * resident_row_count + page_size) {
+            StringPool compacted;
+            for(auto* page : resident_pages) {
+                for(auto& handle : page->descriptions) {
+                    handle = compacted.intern(descriptions.get(handle));
+                }
+            }
+            descriptions = std::move(compacted);
+        }
+    }
+
+    void make_resident(size_t page_num)
+    {
+        auto& page = pages[page_num];
+        page.last_used = ++use_count;
+        if(!page.resident) {
+            try {
+                load_page(page);
+            } catch(const sql_helpers::Error& err) {
+                last_error = QString::fromStdString(err.what());
+                page.clear();
+                page.resident = true;
+            }
+            evict_pages();
+        }
+    }
+
+    // Returns the page containing the given fetched row, fetching it again if needed
+    std::pair<Page*, size_t> locate(int row_num)
+    {
+        auto page_num = static_cast<size_t>(std::ranges::upper_bound(page_starts, row_num) - page_starts.begin() - 1);
+        make_resident(page_num);
+        return {&pages[page_num], static_cast<size_t>(row_num - page_starts[page_num])};
+    }
+
+    // A fetched row's page number and offset within that page
+    using Position = std::pair<size_t, size_t>;
+
+    int row_number(Position position) const
+    {
+        return page_starts[position.first] + static_cast<int>(position.second);
+    }
+
+    // The first page whose key range ends at or after the given key (pages.size() if none do)
+    size_t page_for(RowKey key) const
+    {
+        return std::ranges::lower_bound(pages, key, {}, &Page::last_key) - pages.begin();
+    }
+
+    std::optional<Position> find_row(RowKey key)
+    {
+        auto page_num = page_for(key);
+        if(page_num == pages.size()) {
+            return {};
+        }
+        const auto& page = pages[page_num];
+        auto offset = page.lower_bound(key);
+        if(offset == page.size() || page.key(offset) != key) {
+            return {};
+        }
+        return Position{page_num, offset};
+    }
+
+    // Whether a row with the given key belongs among the rows fetched so far
+    bool in_fetched_range(RowKey key) const
+    {
+        return in_date_range(key) && (fetched_all || (!pages.empty() && key <= pages.back().last_key));
+    }
+
+    // Where a row with the given key (which must be in_fetched_range()) goes among the fetched rows
+    Position insertion_point(RowKey key)
+    {
+        if(pages.empty()) {
+            Page page;
+            page.first_key = key;
+            page.last_key = key;
+            page.resident = true;
+            pages.push_back(std::move(page));
+            page_starts.push_back(0);
+        }
+        auto page_num = std::min(page_for(key), pages.size() - 1);
+        return {page_num, pages[page_num].lower_bound(key)};
+    }
+
+    void erase_row(Position position)
+    {
+        auto[page_num, offset] = position;
+        pages[page_num].erase(offset);
+        --fetched_row_count;
+        for(auto i = page_num + 1; i < page_starts.size(); ++i) {
+            --page_starts[i];
+        }
+        first_changed_page = std::min(first_changed_page, page_num);
+    }
+
+    void insert_row(Position position, const Row& stored_row)
+    {
+        auto[page_num, offset] = position;
+        auto& page = pages[page_num];
+        auto key = stored_key(stored_row);
+        // A page that was fetched again after the submit already has the row
+        if(offset == page.size() || page.key(offset) != key) {
+            insert_stored_row(page, offset, stored_row);
+        }
+        ++page.row_count;
+        page.first_key = std::min(page.first_key, key);
+        page.last_key = std::max(page.last_key, key);
+        ++fetched_row_count;
+        for(auto i = page_num + 1; i < page_starts.size(); ++i) {
+            ++page_starts[i];
+        }
+        first_changed_page = std::min(first_changed_page, page_num);
+    }
+
+    // Carries the running balance forward from the first page that has changed
+    void update_balances()
+    {
+        for(auto page_num = first_changed_page; page_num < pages.size(); ++page_num) {
+            auto& page = pages[page_num];
+            page.opening_balance = page_num == 0 ? opening_balance : pages[page_num - 1].closing_balance;
+            page.compute_balances();
+        }
+        first_changed_page = std::numeric_limits<size_t>::max();
+    }
+
+    // Keeps the pages holding edited and deleted rows in memory until the submit finishes, so
+    // that they still match what the view was shown once the database has changed
+    void pin_edited_pages()
+    {
+        defer_eviction = true;
+        for(const auto& [id, date] : stored_dates) {
+            if(auto position = find_row({date, id})) {
+                make_resident(position->first);
+            }
+        }
+    }
+
+    /* Moves a fetched row (at old_position, if it was fetched) to where its stored values (if it
+       still involves the account) place it among the fetched rows, or removes it if they place it
+       past them. The view is told about the change, and first_changed_row is lowered to the
+       first row whose running balance is affected. Returns whether the row is still fetched */
+    bool place_row(AccountTransactions& model, std::optional<Position> old_position, const Row* stored_row,
+                   int& first_changed_row)
+    {
+        auto keep = stored_row && in_fetched_range(stored_key(*stored_row));
+        if(!old_position) {
+            if(keep) {
+                auto position = insertion_point(stored_key(*stored_row));
+                auto row_num = row_number(position);
+                model.beginInsertRows({}, row_num, row_num);
+                insert_row(position, *stored_row);
+                model.endInsertRows();
+                first_changed_row = std::min(first_changed_row, row_num);
+            }
+            return keep;
+        }
+        auto old_row = row_number(*old_position);
+        first_changed_row = std::min(first_changed_row, old_row);
+        if(!keep) {
+            model.beginRemoveRows({}, old_row, old_row);
+            erase_row(*old_position);
+            model.endRemoveRows();
+            return false;
+        }
+        auto new_key = stored_key(*stored_row);
+        // The row number it will have once it is taken out of its old position
+        auto new_row = row_number(insertion_point(new_key));
+        if(new_row > old_row) {
+            --new_row;
+        }
+        first_changed_row = std::min(first_changed_row, new_row);
+        if(new_row == old_row) {
+            erase_row(*old_position);
+            insert_row(insertion_point(new_key), *stored_row);
+            emit model.dataChanged(model.index(old_row, 0), model.index(old_row, column_count() - 1));
+        } else {
+            model.beginMoveRows({}, old_row, old_row, {}, new_row > old_row ? new_row + 1 : new_row);
+            erase_row(*old_position);
+            insert_row(insertion_point(new_key), *stored_row);
+            model.endMoveRows();
+        }
+        return true;
+    }
+
+    // Carries the running balance past the rows that were placed, and tells the view about it
+    void finish_placing_rows(AccountTransactions& model, int first_changed_row)
+    {
+        // Rows before the date range may have changed too
+        try {
+            if(auto balance = read_opening_balance(); balance != opening_balance) {
+                opening_balance = balance;
+                first_changed_page = 0;
+                first_changed_row = 0;
+            }
+        } catch(const sql_helpers::Error& err) {
+            last_error = QString::fromStdString(err.what());
+        }
+        update_balances();
+        evict_pages();
+        if(first_changed_row < fetched_row_count) {
+            emit model.dataChanged(model.index(first_changed_row, balance_column()),
+                                   model.index(fetched_row_count - 1, balance_column()));
+        }
+    }
+
+    static
+    std::unordered_map<qint64, const Row*> index_by_id(const std::vector<Row>& stored_rows)
+    {
+        std::unordered_map<qint64, const Row*> rows_by_id;
+        for(const auto& stored_row : stored_rows) {
+            rows_by_id.emplace(stored_row[TRANSACTIONS_VIEW_ID].toLongLong(), &stored_row);
+        }
+        return rows_by_id;
+    }
+
+    // Updates the fetched rows to match the changes that were just submitted, moving edited and
+    // new rows to their place in the (date, id) order. Nothing else is fetched again
+    void apply_submit(AccountTransactions& model, const SubmitResult& result)
+    {
+        auto stored_rows = index_by_id(result.stored_rows);
+        auto submitted_updates = std::exchange(updated_rows, {});
+        auto submitted_deletions = std::exchange(deleted_rows, {});
+        auto original_dates = std::exchange(stored_dates, {});
+        auto find_original_row = [&](qint64 id) -> std::optional<Position> {
+            auto it = original_dates.find(id);
+            if(it == original_dates.end()) {
+                return {};
+            }
+            return find_row({it->second, id});
+        };
+        // This submit's own changes are already handled here
+        for(auto id : submitted_deletions) {
+            changed_ids.erase(id);
+        }
+        for(const auto& [id, edits] : submitted_updates) {
+            changed_ids.erase(id);
+        }
+        for(size_t i = 0; i < inserted_rows.size(); ++i) {
+            changed_ids.erase(result.first_inserted_id + static_cast<qint64>(i));
+        }
+        auto first_changed_row = fetched_row_count;
+
+        for(auto id : submitted_deletions) {
+            place_row(model, find_original_row(id), nullptr, first_changed_row);
+        }
+        for(const auto& [id, edits] : submitted_updates) {
+            auto it = stored_rows.find(id);
+            place_row(model, find_original_row(id), it == stored_rows.end() ? nullptr : it->second, first_changed_row);
+        }
+
+        // New rows that belong among the fetched rows are moved there. The rest are dropped (they
+        // will be fetched along with the rows around them)
+        size_t inserted_count = inserted_rows.size();
+        size_t remaining = 0;
+        for(size_t i = 0; i < inserted_count; ++i) {
+            auto it = stored_rows.find(result.first_inserted_id + static_cast<qint64>(i));
+            if(it == stored_rows.end() || !in_fetched_range(stored_key(*it->second))) {
+                ++remaining;
+                continue;
+            }
+            auto source_row = fetched_row_count + static_cast<int>(remaining);
+            auto position = insertion_point(stored_key(*it->second));
+            auto destination_row = row_number(position);
+            first_changed_row = std::min(first_changed_row, destination_row);
+            if(destination_row == source_row) {
+                inserted_rows.erase(inserted_rows.begin() + remaining);
+                insert_row(position, *it->second);
+                emit model.dataChanged(model.index(source_row, 0), model.index(source_row, column_count() - 1));
+            } else {
+                model.beginMoveRows({}, source_row, source_row, {}, destination_row);
+                inserted_rows.erase(inserted_rows.begin() + remaining);
+                insert_row(position, *it->second);
+                model.endMoveRows();
+            }
+        }
+        if(!inserted_rows.empty()) {
+            model.beginRemoveRows({}, fetched_row_count, fetched_row_count + static_cast<int>(inserted_rows.size()) - 1);
+            inserted_rows.clear();
+            model.endRemoveRows();
+        }
+
+        submitting = false;
+        defer_eviction = false;
+        finish_placing_rows(model, first_changed_row);
+    }
+
+    // Updates the fetched rows to match rows that were changed by someone else. stored_rows holds
+    // the changed rows that still involve the account
+    void apply_changes(AccountTransactions& model, const std::vector<qint64>& ids, const std::vector<Row>& stored_rows)
+    {
+        auto rows_by_id = index_by_id(stored_rows);
+        // Where the changed rows were, found with one pass over the keys of the fetched rows
+        std::unordered_set<qint64> wanted_ids(ids.begin(), ids.end());
+        std::unordered_map<qint64, qint64> fetched_dates;
+        for(const auto& page : pages) {
+            for(size_t offset = 0; offset < page.size(); ++offset) {
+                if(wanted_ids.contains(page.ids[offset])) {
+                    fetched_dates.emplace(page.ids[offset], page.dates[offset]);
+                }
+            }
+        }
+        auto first_changed_row = fetched_row_count;
+        for(auto id : ids) {
+            std::optional<Position> old_position;
+            if(auto it = fetched_dates.find(id); it != fetched_dates.end()) {
+                old_position = find_row({it->second, id});
+            }
+            auto it = rows_by_id.find(id);
+            const auto* stored_row = it == rows_by_id.end() ? nullptr : it->second;
+            auto still_fetched = place_row(model, old_position, stored_row, first_changed_row);
+            // Unsubmitted edits to the row stay, as long as it is still there to edit
+            if(still_fetched) {
+                if(auto date = stored_dates.find(id); date != stored_dates.end()) {
+                    date->second = stored_key(*stored_row).date;
+                }
+            } else if(old_position) {
+                updated_rows.erase(id);
+                deleted_rows.erase(id);
+                stored_dates.erase(id);
+            }
+        }
+        finish_placing_rows(model, first_changed_row);
+    }
+
+    QVariant stored_value(const Page& page, size_t offset, int column) const
+    {
+        switch(column) {
+            case TRANSACTIONS_VIEW_ID:
+                return page.ids[offset];
+            case TRANSACTIONS_VIEW_DATE:
+                return QDate::fromJulianDay(page.dates[offset]);
+            case TRANSACTIONS_VIEW_DESCRIPTION:
+                return descriptions.get(page.descriptions[offset]);
+            case TRANSACTIONS_VIEW_SOURCE:
+                return page.sources[offset];
+            case TRANSACTIONS_VIEW_DESTINATION:
+                return page.destinations[offset];
+            default: {
+                if(column == balance_column()) {
+                    return page.balances[offset];
+                }
+                return page.amount_columns[column - TRANSACTIONS_VIEW_COL_COUNT][offset];
+            }
+        }
+    }
+
+    // The value as it is stored (amounts are in fixed-point units), with any unsubmitted edits applied
+    QVariant value(int row_num, int column)
+    {
+        if(row_num >= fetched_row_count) {
+            return inserted_rows[row_num - fetched_row_count][column];
+        }
+        auto[page, offset] = locate(row_num);
+        if(offset >= page->size()) {
+            return {};
+        }
+        if(!updated_rows.empty() && column != balance_column()) {
+            auto it = updated_rows.find(page->ids[offset]);
+            if(it != updated_rows.end()) {
+                return it->second[column];
+            }
+        }
+        return stored_value(*page, offset, column);
+    }
+
+    // Returns nullptr if the row could not be fetched
+    Row* editable_row(int row_num)
+    {
+        if(row_num >= fetched_row_count) {
+            return &inserted_rows[row_num - fetched_row_count];
+        }
+        auto[page, offset] = locate(row_num);
+        if(offset >= page->size()) {
+            return nullptr;
+        }
+        auto[it, inserted] = updated_rows.try_emplace(page->ids[offset]);
+        if(inserted) {
+            stored_dates.emplace(page->ids[offset], page->dates[offset]);
+            it->second.reserve(column_count());
+            for(int col = 0; col < balance_column(); ++col) {
+                it->second.push_back(stored_value(*page, offset, col));
+            }
+            it->second.emplace_back();
+        }
+        return &it->second;
+    }
+
+    // Marks a fetched row to be deleted when the changes are submitted
+    void mark_deleted(int row_num)
+    {
+        auto[page, offset] = locate(row_num);
+        if(offset < page->size()) {
+            deleted_rows.insert(page->ids[offset]);
+            stored_dates.emplace(page->ids[offset], page->dates[offset]);
+        }
+    }
+
+    std::optional<qint64> stored_id(int row_num)
+    {
+        auto[page, offset] = locate(row_num);
+        if(offset >= page->size()) {
+            return {};
+        }
+        return page->ids[offset];
+    }
+
+    bool is_deleted(int row_num)
+    {
+        if(row_num >= fetched_row_count || deleted_rows.empty()) {
+            return false;
+        }
+        auto id = stored_id(row_num);
+        return id && deleted_rows.contains(*id);
+    }
+
+    DatabaseManager* db_manager;
+    // The GUI thread's connection, used for fetching pages
+    QSqlDatabase db;
+    int account_id;
+    // Selects the columns of the view plus the change that each transaction makes to the
+    // account's balance, from the account's postings
+    QString select_text;
+    // Selects the balance of the account before a given day (the parameters are the day, then the account)
+    QString opening_balance_text;
+    // The days (Julian days, inclusive) that rows are shown for, and the balance before them
+    qint64 first_day = std::numeric_limits<qint64>::min();
+    qint64 last_day = std::numeric_limits<qint64>::max();
+    qint64 opening_balance = 0;
+    // The table that the amount columns are stored in, and their names in it
+    QString amount_table;
+    QStringList amount_column_names;
+    // Fixed-point scale of each amount column
+    std::vector<qint64> amount_scales;
+    std::vector<QString> column_names;
+    std::vector<Page> pages;
+    // Row number of the first row of each page
+    std::vector<int> page_starts;
+    StringPool descriptions;
+    int fetched_row_count = 0;
+    bool fetched_all = false;
+    unsigned int use_count = 0;
+    // Set during a submit, so that the pages it changes stay in memory until they are patched
+    bool defer_eviction = false;
+    // The first page whose running balances are out of date
+    size_t first_changed_page = std::numeric_limits<size_t>::max();
+    // Unsubmitted changes. Updates and deletions are keyed by transaction ID so that they
+    // survive their page being evicted. Inserted rows are shown after all fetched rows
+    std::unordered_map<qint64, Row> updated_rows;
+    std::unordered_set<qint64> deleted_rows;
+    std::vector<Row> inserted_rows;
+    // Date (when fetched) of each row that has been edited or deleted, for finding it again after submitting
+    std::unordered_map<qint64, qint64> stored_dates;
+    // Set while changes are being written by the worker thread. No edits are allowed until it finishes
+    bool submitting = false;
+    // IDs of transactions changed by other views (or connections) that haven't been applied yet,
+    // and whether they are being read
+    std::unordered_set<qint64> changed_ids;
+    bool refreshing = false;
+    QString last_error;
+};
+
+AccountTransactions::AccountTransactions(DatabaseManager& db_manager, int account_id, AccountKind account_kind)
+    : QAbstractTableModel(), m_impl(new Impl(db_manager, account_id, account_kind))
+{
+    connect(&db_manager, &DatabaseManager::rows_changed, this, [this](const DatabaseChanges& changes) {
+        for(const auto& table : {u"transactions"_s, m_impl->amount_table}) {
+            if(auto it = changes.find(table); it != changes.end()) {
+                const auto& [inserted, updated, deleted] = it->second;
+                m_impl->changed_ids.insert(inserted.begin(), inserted.end());
+                m_impl->changed_ids.insert(updated.begin(), updated.end());
+                m_impl->changed_ids.insert(deleted.begin(), deleted.end());
+            }
+        }
+        refresh_changed_rows();
+    });
+    fetchMore({});
+}
+
+AccountTransactions::~AccountTransactions() noexcept
+{
+    delete m_impl;
+}
+
+int AccountTransactions::rowCount(const QModelIndex& parent) const
+{
+    if(parent.isValid()) {
+        return 0;
+    }
+    return m_impl->fetched_row_count + static_cast<int>(m_impl->inserted_rows.size());
+}
+
+int AccountTransactions::columnCount(const QModelIndex& parent) const
+{
+    if(parent.isValid()) {
+        return 0;
+    }
+    return m_impl->column_count();
+}
+
+QVariant AccountTransactions::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid()) {
+        return {};
+    }
+    if(role == Pending_Delete_Role) {
+        return m_impl->is_deleted(index.row());
+    }
+    if(index.column() < TRANSACTIONS_VIEW_COL_COUNT) {
+        if(role == Qt::DisplayRole || role == Qt::EditRole) {
+            return m_impl->value(index.row(), index.column());
+        }
+        return {};
+    }
+
+    auto scale = index.column() == m_impl->balance_column()
+        ? Money::scale : m_impl->amount_scales[index.column() - TRANSACTIONS_VIEW_COL_COUNT];
+    switch(role) {
+        case Qt::DisplayRole: {
+            auto units = m_impl->value(index.row(), index.column());
+            if(units.isNull()) {
+                return {};
+            }
+            return fixed_point_text(units.toLongLong(), scale);
+        }
+        case Qt::EditRole: {
+            auto units = m_impl->value(index.row(), index.column());
+            if(units.isNull()) {
+                return QVariant(QMetaType::fromType<double>());
+            }
+            return fixed_point_to_double(units.toLongLong(), scale);
+        }
+        case Qt::TextAlignmentRole:
+            return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+        case Decimal_Places_Role:
+            return decimal_places(scale);
+        default:
+            return {};
+    }
+}
+
+bool AccountTransactions::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+    if(!index.isValid() || role != Qt::EditRole || index.column() == TRANSACTIONS_VIEW_ID
+       || index.column() == m_impl->balance_column() || m_impl->submitting) {
+        return false;
+    }
+    auto* row = m_impl->editable_row(index.row());
+    if(!row) {
+        return false;
+    }
+    if(index.column() >= TRANSACTIONS_VIEW_COL_COUNT) {
+        auto scale = m_impl->amount_scales[index.column() - TRANSACTIONS_VIEW_COL_COUNT];
+        (*row)[index.column()] = fixed_point_from_double(value.toDouble(), scale);
+    } else {
+        (*row)[index.column()] = value;
+    }
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+    return true;
+}
+
+QVariant AccountTransactions::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(role != Qt::DisplayRole) {
+        return {};
+    }
+    if(orientation == Qt::Horizontal) {
+        if(section < 0 || section >= m_impl->column_count()) {
+            return {};
+        }
+        return m_impl->column_names[section];
+    }
+    // Same markers that QSqlTableModel uses for pending insertions/deletions
+    if(section >= m_impl->fetched_row_count) {
+        return u"*"_s;
+    } else if(m_impl->is_deleted(section)) {
+        return u"!"_s;
+    }
+    return section + 1;
+}
+
+Qt::ItemFlags AccountTransactions::flags(const QModelIndex& index) const
+{
+    auto flags = QAbstractTableModel::flags(index);
+    if(index.isValid() && index.column() != TRANSACTIONS_VIEW_ID && index.column() != m_impl->balance_column()
+       && !m_impl->submitting) {
+        flags |= Qt::ItemIsEditable;
+    }
+    return flags;
+}
+
+bool AccountTransactions::canFetchMore(const QModelIndex& parent) const
+{
+    // Rows fetched while a submit is in progress could already include its changes
+    return !parent.isValid() && !m_impl->fetched_all && !m_impl->submitting;
+}
+
+void AccountTransactions::fetchMore(const QModelIndex& parent)
+{
+    if(parent.isValid() || m_impl->fetched_all) {
+        return;
+    }
+    Page page;
+    try {
+        page = m_impl->fetch_next_page();
+    } catch(const sql_helpers::Error& err) {
+        m_impl->last_error = QString::fromStdString(err.what());
+        m_impl->fetched_all = true;
+        return;
+    }
+    if(page.row_count < page_size) {
+        m_impl->fetched_all = true;
+    }
+    if(page.row_count == 0) {
+        return;
+    }
+    auto first_row = m_impl->fetched_row_count;
+    beginInsertRows({}, first_row, first_row + page.row_count - 1);
+    page.last_used = ++m_impl->use_count;
+    m_impl->fetched_row_count += page.row_count;
+    m_impl->pages.push_back(std::move(page));
+    m_impl->page_starts.push_back(first_row);
+    endInsertRows();
+    m_impl->evict_pages();
+}
+
+bool AccountTransactions::insertRows(int row, int count, const QModelIndex& parent)
+{
+    // New rows always go after the fetched rows, since their place in the (date, id) order
+    // isn't known until they are submitted
+    if(parent.isValid() || count < 1 || row < m_impl->fetched_row_count || row > rowCount() || m_impl->submitting) {
+        return false;
+    }
+    Row new_row(m_impl->column_count());
+    new_row[TRANSACTIONS_VIEW_DATE] = QDate();
+    new_row[TRANSACTIONS_VIEW_DESCRIPTION] = QVariant(QMetaType::fromType<QString>());
+    new_row[TRANSACTIONS_VIEW_SOURCE] = QVariant(QMetaType::fromType<int>());
+    new_row[TRANSACTIONS_VIEW_DESTINATION] = QVariant(QMetaType::fromType<int>());
+    beginInsertRows({}, row, row + count - 1);
+    auto position = m_impl->inserted_rows.begin() + (row - m_impl->fetched_row_count);
+    m_impl->inserted_rows.insert(position, count, new_row);
+    endInsertRows();
+    return true;
+}
+
+bool AccountTransactions::removeRows(int row, int count, const QModelIndex& parent)
+{
+    if(parent.isValid() || count < 1 || row < 0 || row + count > rowCount() || m_impl->submitting) {
+        return false;
+    }
+    for(int row_num = row + count - 1; row_num >= row; --row_num) {
+        if(row_num >= m_impl->fetched_row_count) {
+            // Unsubmitted rows can be dropped right away
+            beginRemoveRows({}, row_num, row_num);
+            m_impl->inserted_rows.erase(m_impl->inserted_rows.begin() + (row_num - m_impl->fetched_row_count));
+            endRemoveRows();
+        } else {
+            m_impl->mark_deleted(row_num);
+            emit dataChanged(index(row_num, 0), index(row_num, m_impl->column_count() - 1), {Pending_Delete_Role});
+            emit headerDataChanged(Qt::Vertical, row_num, row_num);
+        }
+    }
+    return true;
+}
+
+QSqlDatabase AccountTransactions::database() const
+{
+    return m_impl->db;
+}
+
+bool AccountTransactions::is_dirty() const
+{
+    return !m_impl->updated_rows.empty() || !m_impl->deleted_rows.empty() || !m_impl->inserted_rows.empty();
+}
+
+QString AccountTransactions::last_error() const
+{
+    return m_impl->last_error;
+}
+
+bool AccountTransactions::set_date_range(QDate first, QDate last)
+{
+    auto& impl = *m_impl;
+    if(impl.submitting || is_dirty()) {
+        return false;
+    }
+    beginResetModel();
+    impl.first_day = first.isNull() ? std::numeric_limits<qint64>::min() : first.toJulianDay();
+    impl.last_day = last.isNull() ? std::numeric_limits<qint64>::max() : last.toJulianDay();
+    impl.pages.clear();
+    impl.page_starts.clear();
+    impl.descriptions = {};
+    impl.fetched_row_count = 0;
+    impl.fetched_all = false;
+    impl.first_changed_page = std::numeric_limits<size_t>::max();
+    try {
+        impl.opening_balance = impl.read_opening_balance();
+    } catch(const sql_helpers::Error& err) {
+        impl.last_error = QString::fromStdString(err.what());
+        impl.opening_balance = 0;
+    }
+    endResetModel();
+    fetchMore({});
+    return true;
+}
+
+void AccountTransactions::submit_all()
+{
+    auto& impl = *m_impl;
+    if(impl.submitting) {
+        return;
+    }
+    impl.submitting = true;
+    impl.pin_edited_pages();
+    std::vector<qint64> deleted_ids(impl.deleted_rows.begin(), impl.deleted_rows.end());
+    std::vector<std::pair<qint64, Row>> updated_rows;
+    for(const auto& [id, row] : impl.updated_rows) {
+        if(!impl.deleted_rows.contains(id)) {
+            updated_rows.emplace_back(id, row);
+        }
+    }
+    // The worker thread gets its own copy of the changes. They are applied in a single
+    // transaction so that a failed submit leaves the database untouched and can be retried
+    impl.db_manager->run_async([account_id = impl.account_id, select_text = impl.select_text,
+                                column_count = impl.column_count(),
+                                amount_table = impl.amount_table, amount_column_names = impl.amount_column_names,
+                                deleted_ids = std::move(deleted_ids), updated_rows = std::move(updated_rows),
+                                inserted_rows = impl.inserted_rows](QSqlDatabase& db) {
+        // Changes are written straight to the tables (rather than through the views' triggers),
+        // with many rows per statement
+        auto amount_count = static_cast<int>(amount_column_names.size());
+        auto bind_amount_columns = [amount_count](QSqlQuery& query, const Row& row) {
+            for(int i = 0; i < amount_count; ++i) {
+                query.addBindValue(row[TRANSACTIONS_VIEW_COL_COUNT + i]);
+            }
+        };
+        sql_helpers::Transaction transaction{db};
+
+        // Deleting a transaction also deletes its amounts
+        sql_helpers::exec_batched(db, deleted_ids.size(), 1, [](size_t count) {
+            return u"DELETE FROM transactions WHERE id IN (%1)"_s
+                   .arg(QStringList(static_cast<qsizetype>(count), u"?"_s).join(u", "));
+        }, [&](QSqlQuery& query, size_t i) {
+            query.addBindValue(deleted_ids[i]);
+        });
+
+        // The VALUES rows are (id, new values...), and SQLite names their columns column1, column2, ...
+        sql_helpers::exec_batched(db, updated_rows.size(), 5, [](size_t count) {
+            return u"UPDATE transactions"
+                    " SET date = v.column2, description = v.column3, source = v.column4, destination = v.column5"
+                    " FROM (VALUES %1) AS v WHERE transactions.id = v.column1"_s
+                   .arg(sql_helpers::values_placeholders(count, 5));
+        }, [&](QSqlQuery& query, size_t i) {
+            query.addBindValue(updated_rows[i].first);
+            bind_transaction_columns(query, updated_rows[i].second);
+        });
+        QStringList amount_assignments;
+        for(int i = 0; i < amount_count; ++i) {
+            amount_assignments.push_back(u"%1 = v.column%2"_s.arg(amount_column_names[i]).arg(i + 2));
+        }
+        sql_helpers::exec_batched(db, updated_rows.size(), 1 + amount_count, [&](size_t count) {
+            return u"UPDATE %1 SET %2 FROM (VALUES %3) AS v WHERE transaction_id = v.column1"_s
+                   .arg(amount_table, amount_assignments.join(u", "),
+                        sql_helpers::values_placeholders(count, 1 + amount_count));
+        }, [&](QSqlQuery& query, size_t i) {
+            query.addBindValue(updated_rows[i].first);
+            bind_amount_columns(query, updated_rows[i].second);
+        });
+
+        // New rows are given IDs up front (the same ones SQLite would pick) so that their amounts
+        // can be inserted in bulk too
+        auto& max_id_query = sql_helpers::prepared(db, u"SELECT coalesce(max(id), 0) FROM transactions"_s);
+        sql_helpers::exec(max_id_query);
+        sql_helpers::next(max_id_query);
+        auto first_id = max_id_query.value(0).toLongLong() + 1;
+        max_id_query.finish();
+        sql_helpers::exec_batched(db, inserted_rows.size(), 5, [](size_t count) {
+            return u"INSERT INTO transactions(id, date, description, source, destination) VALUES %1"_s
+                   .arg(sql_helpers::values_placeholders(count, 5));
+        }, [&](QSqlQuery& query, size_t i) {
+            query.addBindValue(first_id + static_cast<qint64>(i));
+            bind_transaction_columns(query, inserted_rows[i]);
+        });
+        sql_helpers::exec_batched(db, inserted_rows.size(), 1 + amount_count, [&](size_t count) {
+            return u"INSERT INTO %1(transaction_id, %2) VALUES %3"_s
+                   .arg(amount_table, amount_column_names.join(u", "),
+                        sql_helpers::values_placeholders(count, 1 + amount_count));
+        }, [&](QSqlQuery& query, size_t i) {
+            query.addBindValue(first_id + static_cast<qint64>(i));
+            bind_amount_columns(query, inserted_rows[i]);
+        });
+
+        // Read back the rows that were written (as the triggers and views see them) so that the
+        // model can be patched in place instead of fetching everything again
+        SubmitResult result{first_id, {}};
+        std::vector<qint64> written_ids;
+        written_ids.reserve(updated_rows.size() + inserted_rows.size());
+        for(const auto& [id, row] : updated_rows) {
+            written_ids.push_back(id);
+        }
+        for(size_t i = 0; i < inserted_rows.size(); ++i) {
+            written_ids.push_back(first_id + static_cast<qint64>(i));
+        }
+        result.stored_rows = read_stored_rows(db, select_text, account_id, column_count, written_ids);
+
+        transaction.commit();
+        return result;
+    }).then(this, [this](const SubmitResult& result) {
+        m_impl->apply_submit(*this, result);
+        emit submitted();
+        refresh_changed_rows();
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        m_impl->submitting = false;
+        m_impl->defer_eviction = false;
+        m_impl->evict_pages();
+        m_impl->last_error = QString::fromStdString(err.what());
+        emit submit_failed(m_impl->last_error);
+        refresh_changed_rows();
+    });
+}
+
+void AccountTransactions::refresh_changed_rows()
+{
+    auto& impl = *m_impl;
+    // Changes that arrive in the meantime are applied once the submit or refresh finishes
+    if(impl.changed_ids.empty() || impl.submitting || impl.refreshing) {
+        return;
+    }
+    impl.refreshing = true;
+    std::vector<qint64> ids(impl.changed_ids.begin(), impl.changed_ids.end());
+    impl.changed_ids.clear();
+    impl.db_manager->run_async([select_text = impl.select_text, account_id = impl.account_id,
+                                column_count = impl.column_count(), ids](QSqlDatabase& db) {
+        return read_stored_rows(db, select_text, account_id, column_count, ids);
+    }).then(this, [this, ids](const std::vector<Row>& stored_rows) {
+        m_impl->refreshing = false;
+        m_impl->apply_changes(*this, ids, stored_rows);
+        refresh_changed_rows();
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        m_impl->refreshing = false;
+        m_impl->last_error = QString::fromStdString(err.what());
+    });
+}
+
+void AccountTransactions::revert_all()
+{
+    auto& impl = *m_impl;
+    if(impl.submitting) {
+        return;
+    }
+    if(!impl.inserted_rows.empty()) {
+        beginRemoveRows({}, impl.fetched_row_count, rowCount() - 1);
+        impl.inserted_rows.clear();
+        endRemoveRows();
+    }
+    impl.updated_rows.clear();
+    impl.deleted_rows.clear();
+    impl.stored_dates.clear();
+    if(impl.fetched_row_count > 0) {
+        emit dataChanged(index(0, 0), index(impl.fetched_row_count - 1, impl.column_count() - 1));
+        emit headerDataChanged(Qt::Vertical, 0, impl.fetched_row_count - 1);
     }
-    return data;
 }
@@ -18,13 +18,54 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
-#include <QSqlTableModel>
+#include <QAbstractTableModel>
+#include <QDate>
+#include <QSqlDatabase>
+#include <QString>
 #include "models/SQLColumns.hpp"
 
-class AccountTransactions : public QSqlTableModel {
+class DatabaseManager;
+
+/* The transactions involving a single account, in (date, id) order. Rows are fetched a page
+   at a time as the view scrolls (keyset pagination on (date, id)), and only a bounded window of
+   pages is kept in memory. Edits are held until submit_all() is called, which writes them on the
+   database worker thread and then updates only the affected rows in place. Changes made by other
+   views are applied the same way. The last column is the running balance of the account, which is read-only */
+class AccountTransactions : public QAbstractTableModel {
     Q_OBJECT
 public:
-    AccountTransactions(QSqlDatabase&, int account_id, AccountKind);
+    AccountTransactions(DatabaseManager&, int account_id, AccountKind);
+    ~AccountTransactions() noexcept;
+
+    int rowCount(const QModelIndex& parent = {}) const override;
+    int columnCount(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex&, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex&, const QVariant& value, int role = Qt::EditRole) override;
+    QVariant headerData(int section, Qt::Orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex&) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+    bool insertRows(int row, int count, const QModelIndex& parent = {}) override;
+    bool removeRows(int row, int count, const QModelIndex& parent = {}) override;
+
+    QSqlDatabase database() const;
+    bool is_dirty() const;
+    QString last_error() const;
+    // Shows only the transactions dated from first to last (inclusive). A null date leaves that
+    // end of the range open. Returns false (changing nothing) while there are unsubmitted changes
+    bool set_date_range(QDate first, QDate last);
+public slots:
+    void submit_all();
+    void revert_all();
+signals:
+    // Emitted once submit_all() has written the changes to the database
+    void submitted();
+    void submit_failed(QString error_message);
+private:
+    // Re-reads the rows that other views have changed (see DatabaseManager::rows_changed())
+    // and moves them into place
+    void refresh_changed_rows();
 
-    QVariant data(const QModelIndex&, int role) const override;
+    struct Impl;
+    Impl* m_impl;
 };
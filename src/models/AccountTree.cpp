@@ -17,29 +17,239 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "AccountTree.hpp"
-#include <algorithm>
+#include <utility>
 #include <vector>
+#include <QHash>
+#include <QPersistentModelIndex>
+#include <QSet>
+#include <QSqlDatabase>
 #include <QSqlQuery>
-#include <QStandardItem>
 #include <QString>
+#include <QStringList>
+#include <QStringView>
 #include "DatabaseManager.hpp"
+#include "Money.hpp"
 #include "Roles.hpp"
 #include "util/sql_helpers.hpp"
 
 using namespace Qt::StringLiterals;
 
+enum ChildrenState : quint8 {
+    Children_Fetched,
+    Children_Unfetched, // Has children, but they haven't been fetched yet (see fetchMore())
+    Children_Fetching
+};
+
 struct AccountTree::Impl {
+    static constexpr int Root = 0;
+
+    // Removes every node except for the invisible root
+    void clear()
+    {
+        parents.assign(1, -1);
+        rows.assign(1, 0);
+        children.assign(1, {});
+        paths.assign(1, {});
+        name_starts.assign(1, 0);
+        account_ids.assign(1, 0);
+        kinds.assign(1, 0);
+        children_states.assign(1, Children_Fetched);
+        nodes_by_account.clear();
+        nodes_by_path.clear();
+        account_balances.clear();
+        subtree_balances.clear();
+    }
+
+    // Adds a node after the parent's last child, returning its number
+    int add_node(int parent, const QString& name)
+    {
+        auto node = static_cast<int>(parents.size());
+        auto prefix = parent == Root ? QString() : paths[parent] + u':';
+        parents.push_back(parent);
+        rows.push_back(static_cast<int>(children[parent].size()));
+        children[parent].push_back(node);
+        children.emplace_back();
+        name_starts.push_back(prefix.size());
+        paths.push_back(prefix + name);
+        nodes_by_path.insert(paths.back(), node);
+        account_ids.push_back(0);
+        kinds.push_back(0);
+        children_states.push_back(Children_Fetched);
+        return node;
+    }
+
+    void set_account(int node, int account_id, int kind)
+    {
+        account_ids[node] = account_id;
+        kinds[node] = kind;
+        nodes_by_account.insert(account_id, node);
+    }
+
+    void set_path(int node, QString path)
+    {
+        nodes_by_path.remove(paths[node]);
+        nodes_by_path.insert(path, node);
+        paths[node] = std::move(path);
+    }
+
+    // Unlinks the children (and everything below them) from their parent
+    void detach(int parent, int row, int count)
+    {
+        auto& siblings = children[parent];
+        std::vector<int> removed(siblings.begin() + row, siblings.begin() + row + count);
+        siblings.erase(siblings.begin() + row, siblings.begin() + row + count);
+        renumber(parent, row);
+        while(!removed.empty()) {
+            auto node = removed.back();
+            removed.pop_back();
+            removed.insert(removed.end(), children[node].begin(), children[node].end());
+            if(account_ids[node] != 0) {
+                nodes_by_account.remove(account_ids[node]);
+            }
+            nodes_by_path.remove(paths[node]);
+            parents[node] = -1;
+            children[node] = {};
+            paths[node] = {};
+            account_ids[node] = 0;
+        }
+    }
+
+    // Moves the node (along with everything below it) after new_parent's last child
+    void reattach(int node, int new_parent)
+    {
+        auto old_parent = parents[node];
+        children[old_parent].erase(children[old_parent].begin() + rows[node]);
+        renumber(old_parent, rows[node]);
+        parents[node] = new_parent;
+        rows[node] = static_cast<int>(children[new_parent].size());
+        children[new_parent].push_back(node);
+    }
+
+    void renumber(int parent, int first_row)
+    {
+        const auto& siblings = children[parent];
+        for(auto i = static_cast<size_t>(first_row); i < siblings.size(); ++i) {
+            rows[siblings[i]] = static_cast<int>(i);
+        }
+    }
+
+    // Replaces the start of the paths of the node and everything below it that has been fetched
+    void replace_paths(int node, const QString& new_path)
+    {
+        auto old_size = paths[node].size();
+        std::vector<int> pending{node};
+        while(!pending.empty()) {
+            auto current = pending.back();
+            pending.pop_back();
+            pending.insert(pending.end(), children[current].begin(), children[current].end());
+            set_path(current, new_path + QStringView(paths[current]).mid(old_size));
+            name_starts[current] += new_path.size() - old_size;
+        }
+        name_starts[node] = new_path.lastIndexOf(u':') + 1;
+    }
+
+    // -1 if the parent has no child with the given name
+    int find_child(int parent, QStringView name) const
+    {
+        for(auto child : children[parent]) {
+            if(this->name(child) == name) {
+                return child;
+            }
+        }
+        return -1;
+    }
+
+    int node(const QModelIndex& index) const
+    {
+        return index.isValid() ? static_cast<int>(index.internalId()) : Root;
+    }
+
+    QStringView name(int node) const
+    {
+        return QStringView(paths[node]).mid(name_starts[node]);
+    }
+
     DatabaseManager* db_manager;
+    AccountDirectory account_directory;
+    // Incremented whenever the tree is cleared so that the results of a load that was started
+    // before then are thrown away
+    unsigned int load_gen = 0;
+
+    // The fields of each node, indexed by node number (which is also the internal ID of the
+    // node's model indexes). Node 0 is the invisible root. The slots of removed nodes aren't
+    // reused until the tree is next cleared
+    std::vector<int> parents;
+    std::vector<int> rows; // Position among the parent's children
+    std::vector<std::vector<int>> children;
+    std::vector<QString> paths;
+    std::vector<qsizetype> name_starts; // Where the last part of the path starts
+    // 0 if the node is only an ancestor of accounts (or its account hasn't been inserted yet)
+    std::vector<int> account_ids;
+    std::vector<int> kinds;
+    std::vector<ChildrenState> children_states;
+    QHash<int, int> nodes_by_account;
+    QHash<QString, int> nodes_by_path;
+
+    // The current balance of every account, and the total balance under every level of the
+    // hierarchy (including the level's own account, if it is one), whether fetched or not. Both
+    // are read at load and then only adjusted by the change in each account's balance
+    QHash<int, qint64> account_balances;
+    QHash<QString, qint64> subtree_balances;
 };
 
+namespace {
+
+// A child in the account hierarchy. Not every level of a path has to be an account itself
+// (e.g. "Assets:Bank" when only "Assets:Bank:Checking" exists), in which case id is 0
+struct AccountNode {
+    QString name; // The last part of the path
+    int id = 0;
+    int kind = 0;
+    bool has_children = false;
+};
+
+struct Balances {
+    QHash<int, qint64> accounts;
+    QHash<QString, qint64> subtrees;
+};
+
+} // namespace
+
+static
+std::vector<AccountDirectory::Entry> read_account_names(QSqlDatabase&);
 static
-void build_tree(const QSqlDatabase&, QStandardItem* root);
+std::vector<AccountNode> read_child_accounts(QSqlDatabase&, const QString& parent_path);
+static
+QHash<int, qint64> read_balances(QSqlDatabase&, const std::vector<int>& account_ids);
+static
+QHash<QString, qint64> read_subtree_balances(QSqlDatabase&);
+static
+void rename_accounts(QSqlDatabase&, const QString& old_path, const QString& new_path);
 
 AccountTree::AccountTree(DatabaseManager& db_manager)
-    : QStandardItemModel(), m_impl(new Impl{&db_manager})
+    : QAbstractItemModel(), m_impl(new Impl{&db_manager})
 {
+    m_impl->clear();
     connect(&db_manager, &DatabaseManager::database_loaded, this, &AccountTree::load);
-    connect(&db_manager, &DatabaseManager::database_closing, this, &AccountTree::clear);
+    connect(&db_manager, &DatabaseManager::database_closing, this, [this] {
+        ++m_impl->load_gen;
+        clear();
+        m_impl->account_directory.reset({});
+    });
+    // The balances are kept up to date by triggers, so every change to one shows up here,
+    // whichever view (or connection) made it
+    connect(&db_manager, &DatabaseManager::rows_changed, this, [this](const DatabaseChanges& changes) {
+        auto it = changes.find(u"account_balances"_s);
+        if(it == changes.end() || it->second.updated.empty()) {
+            return;
+        }
+        std::vector<int> account_ids;
+        account_ids.reserve(it->second.updated.size());
+        for(auto account_id : it->second.updated) {
+            account_ids.push_back(static_cast<int>(account_id));
+        }
+        reload_balances(std::move(account_ids));
+    });
 }
 
 AccountTree::~AccountTree() noexcept
@@ -47,69 +257,359 @@ AccountTree::~AccountTree() noexcept
     delete m_impl;
 }
 
+AccountDirectory& AccountTree::account_directory()
+{
+    return m_impl->account_directory;
+}
+
 std::unique_ptr<AccountTransactions> AccountTree::account_transactions(const QModelIndex& index)
 {
-    auto* item = itemFromIndex(index);
-    if(item->hasChildren()) {
-        // Parent accounts don't have transactions of their own
+    auto node = m_impl->node(index);
+    if(hasChildren(index) || m_impl->account_ids[node] == 0) {
+        // Parent accounts don't have transactions of their own, and newly created accounts
+        // can't be opened until they have been inserted
+        return {};
+    }
+    auto account_kind = static_cast<AccountKind>(m_impl->kinds[node]);
+    return std::make_unique<AccountTransactions>(*m_impl->db_manager, m_impl->account_ids[node], account_kind);
+}
+
+std::unique_ptr<SubtreeTransactions> AccountTree::subtree_transactions(const QModelIndex& index)
+{
+    if(!index.isValid()) {
         return {};
     }
-    auto account_id = item->data(Account_ID_Role).toInt();
-    auto account_kind = static_cast<AccountKind>(item->data(Account_Kind_Role).toInt());
-    return std::make_unique<AccountTransactions>(m_impl->db_manager->database(), account_id, account_kind);
+    return std::make_unique<SubtreeTransactions>(*m_impl->db_manager, m_impl->account_directory, m_impl->paths[m_impl->node(index)]);
+}
+
+void AccountTree::clear()
+{
+    beginResetModel();
+    m_impl->clear();
+    endResetModel();
 }
 
 void AccountTree::load()
 {
     clear();
-    build_tree(m_impl->db_manager->database(), invisibleRootItem());
+    auto load_gen = ++m_impl->load_gen;
+    m_impl->db_manager->run_async(read_account_names).then(this, [this, load_gen](std::vector<AccountDirectory::Entry> entries) {
+        if(load_gen == m_impl->load_gen) {
+            m_impl->account_directory.reset(std::move(entries));
+        }
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        emit error_occurred(u"Failed to load accounts\n(Reason: %1)"_s.arg(err.what()));
+    });
+    load_balances();
+    // Only the top-level accounts are loaded up front. The rest are fetched as they are expanded
+    m_impl->children_states[Impl::Root] = Children_Unfetched;
+    fetchMore({});
+}
+
+QModelIndex AccountTree::index(int row, int column, const QModelIndex& parent) const
+{
+    if(column < 0 || column >= Column_Count || row < 0 || parent.column() > 0) {
+        return {};
+    }
+    const auto& siblings = m_impl->children[m_impl->node(parent)];
+    if(static_cast<size_t>(row) >= siblings.size()) {
+        return {};
+    }
+    return createIndex(row, column, static_cast<quintptr>(siblings[row]));
+}
+
+QModelIndex AccountTree::parent(const QModelIndex& index) const
+{
+    if(!index.isValid()) {
+        return {};
+    }
+    auto parent = m_impl->parents[m_impl->node(index)];
+    if(parent == Impl::Root) {
+        return {};
+    }
+    return createIndex(m_impl->rows[parent], 0, static_cast<quintptr>(parent));
+}
+
+QModelIndex AccountTree::node_index(int node, int column) const
+{
+    if(node == Impl::Root) {
+        return {};
+    }
+    return createIndex(m_impl->rows[node], column, static_cast<quintptr>(node));
+}
+
+int AccountTree::rowCount(const QModelIndex& parent) const
+{
+    if(parent.column() > 0) {
+        return 0;
+    }
+    return static_cast<int>(m_impl->children[m_impl->node(parent)].size());
+}
+
+int AccountTree::columnCount(const QModelIndex&) const
+{
+    // Matches QStandardItemModel, which has no columns until something is added
+    return m_impl->children[Impl::Root].empty() ? 0 : Column_Count;
+}
+
+QVariant AccountTree::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
+    }
+    switch(section) {
+        case Name_Column:
+            return u"Name"_s;
+        case Balance_Column:
+            return u"Balance"_s;
+        default:
+            return {};
+    }
+}
+
+Qt::ItemFlags AccountTree::flags(const QModelIndex& index) const
+{
+    if(!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+bool AccountTree::hasChildren(const QModelIndex& parent) const
+{
+    if(parent.column() > 0) {
+        return false;
+    }
+    auto node = m_impl->node(parent);
+    return m_impl->children_states[node] != Children_Fetched || !m_impl->children[node].empty();
+}
+
+bool AccountTree::canFetchMore(const QModelIndex& parent) const
+{
+    return parent.column() <= 0 && m_impl->children_states[m_impl->node(parent)] == Children_Unfetched;
+}
+
+void AccountTree::fetchMore(const QModelIndex& parent)
+{
+    if(!canFetchMore(parent)) {
+        return;
+    }
+    m_impl->children_states[m_impl->node(parent)] = Children_Fetching;
+    auto is_root = !parent.isValid();
+    QPersistentModelIndex parent_index{parent};
+    auto parent_path = is_root ? QString() : m_impl->paths[m_impl->node(parent)];
+    auto load_gen = m_impl->load_gen;
+    m_impl->db_manager->run_async([parent_path](QSqlDatabase& db) {
+        return read_child_accounts(db, parent_path);
+    }).then(this, [this, load_gen, is_root, parent_index](const std::vector<AccountNode>& children) {
+        if(load_gen != m_impl->load_gen || (!is_root && !parent_index.isValid())) {
+            return;
+        }
+        auto parent = m_impl->node(parent_index);
+        m_impl->children_states[parent] = Children_Fetched;
+        // Accounts added while the fetch was running are already there
+        QSet<QString> existing_names;
+        for(auto child : m_impl->children[parent]) {
+            existing_names.insert(m_impl->name(child).toString());
+        }
+        std::vector<const AccountNode*> new_children;
+        for(const auto& child : children) {
+            if(!existing_names.contains(child.name)) {
+                new_children.push_back(&child);
+            }
+        }
+        if(new_children.empty()) {
+            return;
+        }
+        // The column count changes along with the first top-level rows
+        auto first_row = rowCount(parent_index);
+        auto is_first_load = is_root && first_row == 0;
+        if(is_first_load) {
+            beginResetModel();
+        } else {
+            beginInsertRows(parent_index, first_row, first_row + static_cast<int>(new_children.size()) - 1);
+        }
+        for(const auto* child : new_children) {
+            auto node = m_impl->add_node(parent, child->name);
+            if(child->id != 0) {
+                m_impl->set_account(node, child->id, child->kind);
+            }
+            if(child->has_children) {
+                m_impl->children_states[node] = Children_Unfetched;
+            }
+        }
+        if(is_first_load) {
+            endResetModel();
+        } else {
+            endInsertRows();
+        }
+    }).onFailed(this, [this, load_gen, is_root, parent_index](const sql_helpers::Error& err) {
+        if(load_gen == m_impl->load_gen && (is_root || parent_index.isValid())) {
+            m_impl->children_states[m_impl->node(parent_index)] = Children_Unfetched;
+        }
+        emit error_occurred(u"Failed to load accounts\n(Reason: %1)"_s.arg(err.what()));
+    });
+}
+
+void AccountTree::load_balances()
+{
+    auto load_gen = m_impl->load_gen;
+    m_impl->db_manager->run_async([](QSqlDatabase& db) {
+        return Balances{read_balances(db, {}), read_subtree_balances(db)};
+    }).then(this, [this, load_gen](Balances balances) {
+        if(load_gen != m_impl->load_gen) {
+            return;
+        }
+        m_impl->account_balances = std::move(balances.accounts);
+        m_impl->subtree_balances = std::move(balances.subtrees);
+        for(size_t node = 0; node < m_impl->children.size(); ++node) {
+            const auto& children = m_impl->children[node];
+            if(!children.empty()) {
+                emit dataChanged(node_index(children.front()), node_index(children.back(), Balance_Column));
+            }
+        }
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        emit error_occurred(u"Failed to load account balances\n(Reason: %1)"_s.arg(err.what()));
+    });
+}
+
+void AccountTree::reload_balances(std::vector<int> account_ids)
+{
+    auto load_gen = m_impl->load_gen;
+    m_impl->db_manager->run_async([account_ids = std::move(account_ids)](QSqlDatabase& db) {
+        return read_balances(db, account_ids);
+    }).then(this, [this, load_gen](QHash<int, qint64> balances) {
+        if(load_gen != m_impl->load_gen) {
+            return;
+        }
+        for(auto it = balances.cbegin(); it != balances.cend(); ++it) {
+            auto& balance = m_impl->account_balances[it.key()];
+            auto change = it.value() - balance;
+            if(change == 0) {
+                continue;
+            }
+            balance = it.value();
+            if(auto node = m_impl->nodes_by_account.value(it.key(), -1); node >= 0) {
+                auto index = node_index(node);
+                emit dataChanged(index, index, {Account_Balance_Role, Qt::ToolTipRole});
+            }
+            add_to_subtree_balances(m_impl->account_directory.name(it.key()), change);
+        }
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        emit error_occurred(u"Failed to load account balances\n(Reason: %1)"_s.arg(err.what()));
+    });
+}
+
+void AccountTree::add_to_subtree_balances(const QString& path, qint64 change)
+{
+    if(path.isEmpty() || change == 0) {
+        return;
+    }
+    for(auto end = path.indexOf(u':'); ; end = path.indexOf(u':', end + 1)) {
+        auto level = end < 0 ? path : path.left(end);
+        m_impl->subtree_balances[level] += change;
+        if(auto node = m_impl->nodes_by_path.value(level, -1); node >= 0) {
+            auto index = node_index(node, Balance_Column);
+            emit dataChanged(index, index, {Qt::DisplayRole});
+        }
+        if(end < 0) {
+            break;
+        }
+    }
 }
 
 QVariant AccountTree::data(const QModelIndex& index, int role) const
 {
-    if(role == Account_Path_Role && index.isValid()) {
-        auto path = index.data().toString();
-        for(auto it = index.parent(); it.isValid(); it = it.parent()) {
-            path.prepend(':').prepend(it.data().toString());
+    if(!index.isValid()) {
+        return {};
+    }
+    auto node = m_impl->node(index);
+    if(index.column() == Balance_Column) {
+        if(role == Qt::DisplayRole) {
+            return Money::from_units(m_impl->subtree_balances.value(m_impl->paths[node])).to_string();
+        } else if(role == Qt::TextAlignmentRole) {
+            return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
         }
-        return path;
+        return {};
+    }
+    auto account_id = m_impl->account_ids[node];
+    switch(role) {
+        case Qt::DisplayRole:
+        case Qt::EditRole:
+            return m_impl->name(node).toString();
+        case Account_Path_Role:
+            return m_impl->paths[node];
+        case Account_ID_Role:
+            return account_id == 0 ? QVariant() : QVariant(account_id);
+        case Account_Kind_Role:
+            return m_impl->kinds[node] == 0 ? QVariant() : QVariant(m_impl->kinds[node]);
+        case Account_Balance_Role:
+            return account_id == 0 ? QVariant() : QVariant(m_impl->account_balances.value(account_id));
+        case Qt::ToolTipRole:
+            if(account_id == 0) {
+                return {};
+            }
+            return u"Balance: %1"_s.arg(Money::from_units(m_impl->account_balances.value(account_id)).to_string());
+        default:
+            return {};
     }
-    return QStandardItemModel::data(index, role);
 }
 
 bool AccountTree::setData(const QModelIndex& index, const QVariant& value, int role)
 {
-    if(role == Qt::EditRole) {
-        auto fields = qvariant_cast<AccountFields>(value);
-        // Set the item's display data (i.e. the account name). This is needed when
-        // building the account path
-        QStandardItemModel::setData(index, fields.name, role);
-        auto account_path = data(index, Account_Path_Role).toString();
-        QSqlQuery query{m_impl->db_manager->database()};
-        sql_helpers::prepare(query, u"INSERT INTO accounts(name, kind) VALUES (?, ?) RETURNING id"_s);
+    if(role != Qt::EditRole || !index.isValid()) {
+        return false;
+    }
+    auto fields = qvariant_cast<AccountFields>(value);
+    auto node = m_impl->node(index);
+    auto parent = m_impl->parents[node];
+    auto prefix = parent == Impl::Root ? QString() : m_impl->paths[parent] + u':';
+    m_impl->set_path(node, prefix + fields.name);
+    m_impl->name_starts[node] = prefix.size();
+    m_impl->kinds[node] = static_cast<int>(fields.kind);
+    emit dataChanged(index, index);
+    // The account's ID is filled in once it has been inserted
+    auto account_path = m_impl->paths[node];
+    QPersistentModelIndex item{index};
+    m_impl->db_manager->run_async([account_path, fields](QSqlDatabase& db) {
+        auto& query = sql_helpers::prepared(db, u"INSERT INTO accounts(name, kind) VALUES (?, ?) RETURNING id"_s);
         query.bindValue(0, account_path);
         query.bindValue(1, static_cast<int>(fields.kind));
         sql_helpers::exec(query);
         sql_helpers::next(query);
         auto account_id = query.value(0).toInt();
-        QStandardItemModel::setData(index, account_id, Account_ID_Role);
-        QStandardItemModel::setData(index, static_cast<int>(fields.kind), Account_Kind_Role);
+        query.finish();
         if(fields.kind == ACCOUNT_KIND_STOCK) {
-            sql_helpers::prepare(query, u"INSERT INTO account_securities VALUES (?, ?)"_s);
-            query.bindValue(0, account_id);
-            query.bindValue(1, fields.symbol);
-            sql_helpers::exec(query);
+            auto& security_query = sql_helpers::prepared(db, u"INSERT INTO account_securities VALUES (?, ?)"_s);
+            security_query.bindValue(0, account_id);
+            security_query.bindValue(1, fields.symbol);
+            sql_helpers::exec(security_query);
         }
-        return true;
-    }
-    return QStandardItemModel::setData(index, value, role);
+        return account_id;
+    }).then(this, [this, item, account_path](int account_id) {
+        m_impl->account_directory.insert(account_id, account_path);
+        if(item.isValid()) {
+            auto node = m_impl->node(item);
+            m_impl->set_account(node, account_id, m_impl->kinds[node]);
+            m_impl->account_balances.insert(account_id, 0);
+            emit dataChanged(item, item);
+        }
+    }).onFailed(this, [this, item](const sql_helpers::Error& err) {
+        if(item.isValid()) {
+            remove_nodes(item.row(), 1, item.parent());
+        }
+        emit error_occurred(u"Failed to create account\n(Reason: %1)"_s.arg(err.what()));
+    });
+    return true;
 }
 
 QModelIndex AccountTree::appendRow(const AccountFields& fields, const QModelIndex& parent)
 {
-    auto* parent_item = itemFromIndex(parent);
-    parent_item->appendRow(new QStandardItem(fields.name));
-    auto new_item = parent_item->child(parent_item->rowCount() - 1)->index();
+    auto row = rowCount(parent);
+    beginInsertRows(parent, row, row);
+    auto node = m_impl->add_node(m_impl->node(parent), fields.name);
+    endInsertRows();
+    auto new_item = node_index(node);
     QVariant value;
     value.setValue(fields);
     setData(new_item, value);
@@ -118,49 +618,330 @@ QModelIndex AccountTree::appendRow(const AccountFields& fields, const QModelInde
 
 bool AccountTree::removeRows(int row, int count, const QModelIndex& parent)
 {
-    QSqlQuery query{m_impl->db_manager->database()};
+    if(row < 0 || count <= 0 || row + count > rowCount(parent)) {
+        return false;
+    }
+    // The rows are removed once the accounts have been deleted. Accounts are deleted by path so
+    // that ones still being inserted (which have no ID yet) are included
+    const auto& siblings = m_impl->children[m_impl->node(parent)];
+    QStringList paths;
+    std::vector<QPersistentModelIndex> items;
     for(int i = 0; i < count; ++i) {
-        auto index = this->index(row + i, 0, parent);
-        if(!index.data().toString().isEmpty()) {
-            auto account_id = index.data(Account_ID_Role).toInt();
-            sql_helpers::prepare(query, u"DELETE FROM accounts WHERE id = ?"_s);
-            query.bindValue(0, account_id);
+        auto node = siblings[row + i];
+        paths.push_back(m_impl->paths[node]);
+        items.emplace_back(node_index(node));
+    }
+    auto load_gen = m_impl->load_gen;
+    m_impl->db_manager->run_async([paths](QSqlDatabase& db) {
+        sql_helpers::Transaction transaction{db};
+        auto& query = sql_helpers::prepared(db, u"DELETE FROM accounts WHERE name = ? RETURNING id"_s);
+        std::vector<int> account_ids;
+        for(const auto& path : paths) {
+            query.bindValue(0, path);
             sql_helpers::exec(query);
+            while(query.next()) {
+                account_ids.push_back(query.value(0).toInt());
+            }
+            query.finish();
         }
-    }
-    QStandardItemModel::removeRows(row, count, parent);
+        transaction.commit();
+        return account_ids;
+    }).then(this, [this, load_gen, items = std::move(items)](const std::vector<int>& account_ids) {
+        if(load_gen != m_impl->load_gen) {
+            return;
+        }
+        for(auto account_id : account_ids) {
+            add_to_subtree_balances(m_impl->account_directory.name(account_id), -m_impl->account_balances.take(account_id));
+            m_impl->account_directory.remove(account_id);
+        }
+        // Other rows may have been added or moved in the meantime
+        for(const auto& item : items) {
+            if(item.isValid()) {
+                remove_nodes(item.row(), 1, item.parent());
+            }
+        }
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        emit error_occurred(u"Failed to delete account (check that no transactions reference it)\n(Reason: %1)"_s.arg(err.what()));
+    });
     return true;
 }
 
+void AccountTree::move_account(const QModelIndex& index, const QString& new_path)
+{
+    auto node = m_impl->node(index);
+    auto old_path = m_impl->paths[node];
+    if(new_path == old_path) {
+        return;
+    }
+    auto parts = new_path.split(u':');
+    if(m_impl->parents[node] == Impl::Root) {
+        throw sql_helpers::Error("Top-level accounts can't be moved");
+    } else if(parts.contains(QString())) {
+        throw sql_helpers::Error("Account names can't be empty");
+    } else if(parts.size() < 2 || m_impl->find_child(Impl::Root, parts.front()) < 0) {
+        throw sql_helpers::Error("Accounts must be under one of the top-level accounts");
+    } else if(new_path.startsWith(old_path + u':')) {
+        throw sql_helpers::Error("An account can't be moved under itself");
+    }
+
+    auto load_gen = m_impl->load_gen;
+    QPersistentModelIndex item{index};
+    m_impl->db_manager->run_async([old_path, new_path](QSqlDatabase& db) {
+        rename_accounts(db, old_path, new_path);
+    }).then(this, [this, load_gen, item, old_path, new_path] {
+        if(load_gen != m_impl->load_gen) {
+            return;
+        }
+        m_impl->account_directory.move_subtree(old_path, new_path);
+        auto moved_balance = m_impl->subtree_balances.value(old_path);
+        add_to_subtree_balances(old_path.left(old_path.lastIndexOf(u':')), -moved_balance);
+        QHash<QString, qint64> moved_balances;
+        for(auto it = m_impl->subtree_balances.begin(); it != m_impl->subtree_balances.end();) {
+            if(it.key() == old_path || it.key().startsWith(old_path + u':')) {
+                moved_balances.insert(new_path + QStringView(it.key()).mid(old_path.size()), it.value());
+                it = m_impl->subtree_balances.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_impl->subtree_balances.insert(moved_balances);
+        add_to_subtree_balances(new_path.left(new_path.lastIndexOf(u':')), moved_balance);
+        if(item.isValid() && m_impl->paths[m_impl->node(item)] == old_path) {
+            move_node(m_impl->node(item), new_path);
+        }
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        emit error_occurred(u"Failed to move account\n(Reason: %1)"_s.arg(err.what()));
+    });
+}
+
+void AccountTree::move_node(int node, const QString& new_path)
+{
+    // Find the new parent, adding the levels of its path that don't exist yet. If part of the
+    // path hasn't been fetched, the account is just taken out of the tree, since it will be read
+    // along with the rest of its new siblings
+    auto parts = new_path.split(u':');
+    parts.removeLast();
+    int new_parent = Impl::Root;
+    for(const auto& part : parts) {
+        if(m_impl->children_states[new_parent] != Children_Fetched) {
+            new_parent = -1;
+            break;
+        }
+        auto child = m_impl->find_child(new_parent, part);
+        if(child < 0) {
+            auto row = rowCount(node_index(new_parent));
+            beginInsertRows(node_index(new_parent), row, row);
+            child = m_impl->add_node(new_parent, part);
+            endInsertRows();
+        }
+        new_parent = child;
+    }
+    auto old_parent = m_impl->parents[node];
+    if(new_parent < 0) {
+        remove_nodes(m_impl->rows[node], 1, node_index(old_parent));
+    } else {
+        if(new_parent != old_parent) {
+            auto destination = node_index(new_parent);
+            beginMoveRows(node_index(old_parent), m_impl->rows[node], m_impl->rows[node], destination, rowCount(destination));
+            m_impl->reattach(node, new_parent);
+            m_impl->replace_paths(node, new_path);
+            endMoveRows();
+        } else {
+            m_impl->replace_paths(node, new_path);
+        }
+        auto moved = node_index(node);
+        emit dataChanged(moved, node_index(node, Balance_Column));
+        std::vector<int> pending{node};
+        while(!pending.empty()) {
+            auto current = pending.back();
+            pending.pop_back();
+            const auto& children = m_impl->children[current];
+            if(!children.empty()) {
+                emit dataChanged(node_index(children.front()), node_index(children.back(), Balance_Column),
+                                 {Account_Path_Role, Qt::DisplayRole});
+                pending.insert(pending.end(), children.begin(), children.end());
+            }
+        }
+    }
+    // Levels of the old path that were only there for the moved account go away with it
+    while(old_parent != Impl::Root && m_impl->account_ids[old_parent] == 0 && m_impl->children[old_parent].empty()
+          && m_impl->children_states[old_parent] == Children_Fetched) {
+        auto grandparent = m_impl->parents[old_parent];
+        remove_nodes(m_impl->rows[old_parent], 1, node_index(grandparent));
+        old_parent = grandparent;
+    }
+}
+
+void AccountTree::remove_nodes(int row, int count, const QModelIndex& parent)
+{
+    beginRemoveRows(parent, row, count + row - 1);
+    m_impl->detach(m_impl->node(parent), row, count);
+    endRemoveRows();
+}
+
+// Runs on the database worker thread
 static
-void build_tree(const QSqlDatabase& db, QStandardItem* root)
+std::vector<AccountDirectory::Entry> read_account_names(QSqlDatabase& db)
 {
-    QSqlQuery query{db};
-    sql_helpers::exec(query, u"SELECT id, name, kind FROM accounts ORDER BY name"_s);
-    std::vector<QString> account_name_stack{u""_s};
-    std::vector<QStandardItem*> account_stack{root};
+    auto& query = sql_helpers::prepared(db, u"SELECT id, name FROM accounts ORDER BY name"_s);
+    sql_helpers::exec(query);
+    std::vector<AccountDirectory::Entry> entries;
     while(query.next()) {
-        auto account_id = query.value(0).toInt();
-        auto account_path = query.value(1).toString();
-        auto account_kind = query.value(2).toInt();
-        auto parts = account_path.split(':');
-        // Find the point where the stack and account_path differ.
-        // This is the point in the path where new parts need to be added to the tree.
-        auto[first_to_delete, first_new_part] = std::mismatch(account_name_stack.begin() + 1, account_name_stack.end(), parts.begin(), parts.end());
-        size_t start_pt = first_to_delete - account_name_stack.begin();
-        account_stack.erase(account_stack.begin() + start_pt, account_stack.end());
-        account_name_stack.erase(account_name_stack.begin() + start_pt, account_name_stack.end());
-        // Add the new parts to the tree
-        for(auto part = first_new_part; part != parts.end(); ++part) {
-            auto* new_item = new QStandardItem(*part);
-            account_stack.back()->appendRow(new_item);
-            account_stack.push_back(new_item);
-            account_name_stack.push_back(*part);
-        }
-        if(!account_stack.empty()) {
-            auto* new_account = account_stack.back();
-            new_account->setData(account_id, Account_ID_Role);
-            new_account->setData(account_kind, Account_Kind_Role);
+        entries.push_back({query.value(0).toInt(), query.value(1).toString()});
+    }
+    query.finish();
+    return entries;
+}
+
+/* Runs on the database worker thread. Finds the children of the given path (or the top-level
+   accounts, if it is empty) using range scans over the index on accounts.name: every name in
+   the subtree of "A:B" falls in ["A:B:", "A:B;"), since ';' comes right after ':'. Each child
+   costs a few index seeks, however many accounts are below it */
+static
+std::vector<AccountNode> read_child_accounts(QSqlDatabase& db, const QString& parent_path)
+{
+    auto is_root = parent_path.isEmpty();
+    auto prefix = is_root ? QString() : parent_path + u':';
+    auto& next_query = sql_helpers::prepared(db, is_root
+        ? u"SELECT id, name, kind FROM accounts WHERE name > ? ORDER BY name LIMIT 1"_s
+        : u"SELECT id, name, kind FROM accounts WHERE name > ? AND name < ? ORDER BY name LIMIT 1"_s);
+    auto& subtree_query = sql_helpers::prepared(db, u"SELECT max(name) FROM accounts WHERE name >= ? AND name < ?"_s);
+
+    std::vector<AccountNode> children;
+    // The last name in the subtree of each child seen so far (that has children)
+    QHash<QString, QString> subtree_ends;
+    // Names are visited in order, but siblings can sort between an account and its subtree
+    // (e.g. "A:B-2" comes between "A:B" and "A:B:C"), so subtrees are skipped when reached
+    auto cursor = prefix;
+    while(true) {
+        next_query.addBindValue(cursor);
+        if(!is_root) {
+            next_query.addBindValue(parent_path + u';');
+        }
+        sql_helpers::exec(next_query);
+        if(!next_query.next()) {
+            next_query.finish();
+            break;
+        }
+        auto name = next_query.value(1).toString();
+        AccountNode node{.id = next_query.value(0).toInt(), .kind = next_query.value(2).toInt()};
+        next_query.finish();
+
+        auto separator = name.indexOf(u':', prefix.size());
+        auto child_path = separator < 0 ? name : name.left(separator);
+        if(auto it = subtree_ends.constFind(child_path); it != subtree_ends.cend()) {
+            cursor = it.value();
+            continue;
         }
+        subtree_query.addBindValue(child_path + u':');
+        subtree_query.addBindValue(child_path + u';');
+        sql_helpers::exec(subtree_query);
+        sql_helpers::next(subtree_query);
+        auto subtree_end = subtree_query.value(0);
+        subtree_query.finish();
+
+        node.name = child_path.mid(prefix.size());
+        node.has_children = !subtree_end.isNull();
+        if(node.has_children) {
+            subtree_ends.insert(child_path, subtree_end.toString());
+        }
+        if(separator < 0) {
+            cursor = name;
+        } else {
+            // Only an ancestor of this account, so everything up to the end of its subtree is skipped
+            node = AccountNode{.name = node.name, .has_children = true};
+            cursor = subtree_end.toString();
+        }
+        children.push_back(std::move(node));
+    }
+    return children;
+}
+
+// Runs on the database worker thread. Reads the balances of all accounts if account_ids is empty
+static
+QHash<int, qint64> read_balances(QSqlDatabase& db, const std::vector<int>& account_ids)
+{
+    QHash<int, qint64> balances;
+    auto read_results = [&balances](QSqlQuery& query) {
+        while(query.next()) {
+            balances.insert(query.value(0).toInt(), query.value(1).toLongLong());
+        }
+    };
+    if(account_ids.empty()) {
+        auto& query = sql_helpers::prepared(db, u"SELECT account_id, balance FROM account_balances"_s);
+        sql_helpers::exec(query);
+        read_results(query);
+        query.finish();
+    } else {
+        sql_helpers::exec_batched(db, account_ids.size(), 1, [](size_t count) {
+            return u"SELECT account_id, balance FROM account_balances WHERE account_id IN (%1)"_s
+                   .arg(QStringList(static_cast<qsizetype>(count), u"?"_s).join(u", "));
+        }, [&account_ids](QSqlQuery& query, size_t i) {
+            query.addBindValue(account_ids[i]);
+        }, read_results);
+    }
+    return balances;
+}
+
+// Runs on the database worker thread. Totals the balances under every level of the hierarchy
+static
+QHash<QString, qint64> read_subtree_balances(QSqlDatabase& db)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT a.ancestor, sum(b.balance) FROM account_closure a"
+                                             " JOIN account_balances b ON b.account_id = a.account_id"
+                                             " GROUP BY a.ancestor"_s);
+    sql_helpers::exec(query);
+    QHash<QString, qint64> balances;
+    while(query.next()) {
+        balances.insert(query.value(0).toString(), query.value(1).toLongLong());
+    }
+    query.finish();
+    return balances;
+}
+
+/* Runs on the database worker thread. Every name in the subtree of "A:B" falls in
+   ["A:B:", "A:B;"), so the whole subtree is renamed by one statement using the index on
+   accounts.name. Throws sql_helpers::Error if new_path is already taken or if one of the
+   accounts above it isn't a placeholder (only placeholders can have subaccounts) */
+static
+void rename_accounts(QSqlDatabase& db, const QString& old_path, const QString& new_path)
+{
+    sql_helpers::Transaction transaction{db};
+    QStringList ancestors;
+    for(auto end = new_path.indexOf(u':'); end >= 0; end = new_path.indexOf(u':', end + 1)) {
+        ancestors.push_back(new_path.left(end));
+    }
+    QSqlQuery ancestor_query{db};
+    sql_helpers::prepare(ancestor_query, u"SELECT name FROM accounts WHERE name IN (%1) AND kind != ? LIMIT 1"_s
+                                          .arg(QStringList(ancestors.size(), u"?"_s).join(u", ")));
+    for(const auto& ancestor : ancestors) {
+        ancestor_query.addBindValue(ancestor);
+    }
+    ancestor_query.addBindValue(static_cast<int>(ACCOUNT_KIND_PLACEHOLDER));
+    sql_helpers::exec(ancestor_query);
+    if(ancestor_query.next()) {
+        throw sql_helpers::Error(u"'%1' isn't a placeholder account, so it can't have subaccounts"_s
+                                 .arg(ancestor_query.value(0).toString()).toStdString());
+    }
+    ancestor_query.finish();
+    auto& taken_query = sql_helpers::prepared(db, u"SELECT 1 FROM accounts WHERE name = ? OR (name > ? AND name < ?) LIMIT 1"_s);
+    taken_query.addBindValue(new_path);
+    taken_query.addBindValue(new_path + u':');
+    taken_query.addBindValue(new_path + u';');
+    sql_helpers::exec(taken_query);
+    auto is_taken = taken_query.next();
+    taken_query.finish();
+    if(is_taken) {
+        throw sql_helpers::Error(u"'%1' already exists"_s.arg(new_path).toStdString());
     }
+    // length() counts characters, not UTF-16 code units like QString::size()
+    auto& query = sql_helpers::prepared(db, u"UPDATE accounts SET name = ? || substr(name, length(?) + 1)"
+                                             " WHERE name = ? OR (name > ? AND name < ?)"_s);
+    query.addBindValue(new_path);
+    query.addBindValue(old_path);
+    query.addBindValue(old_path);
+    query.addBindValue(old_path + u':');
+    query.addBindValue(old_path + u';');
+    sql_helpers::exec(query);
+    transaction.commit();
 }
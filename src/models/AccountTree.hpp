@@ -19,10 +19,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include <memory>
-#include <QStandardItemModel>
+#include <vector>
+#include <QAbstractItemModel>
 #include <QString>
 #include "models/SQLColumns.hpp"
+#include "AccountDirectory.hpp"
 #include "AccountTransactions.hpp"
+#include "SubtreeTransactions.hpp"
 
 class DatabaseManager;
 
@@ -33,21 +36,68 @@ struct AccountFields {
 };
 Q_DECLARE_METATYPE(AccountFields);
 
-class AccountTree : public QStandardItemModel {
+/* The account hierarchy, built from the colon-separated account paths. Nodes are kept in flat
+   arrays (one per field) instead of one item object per account, and each node's full path is
+   stored so that Account_Path_Role doesn't have to be rebuilt from its ancestors */
+class AccountTree : public QAbstractItemModel {
     Q_OBJECT
 public:
+    enum Column {
+        Name_Column,
+        // Balance of the account plus everything below it
+        Balance_Column,
+
+        Column_Count
+    };
+
     explicit
     AccountTree(DatabaseManager&);
     ~AccountTree() noexcept;
 
+    // Kept up to date as accounts are loaded, inserted, and removed
+    AccountDirectory& account_directory();
     std::unique_ptr<AccountTransactions> account_transactions(const QModelIndex&);
+    // All transactions under the given level of the hierarchy (which doesn't have to be an account)
+    std::unique_ptr<SubtreeTransactions> subtree_transactions(const QModelIndex&);
+    using QObject::parent;
+    QModelIndex index(int row, int column, const QModelIndex& parent = {}) const override;
+    QModelIndex parent(const QModelIndex&) const override;
+    int rowCount(const QModelIndex& parent = {}) const override;
+    int columnCount(const QModelIndex& parent = {}) const override;
+    QVariant headerData(int section, Qt::Orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex&) const override;
     QVariant data(const QModelIndex&, int role = Qt::DisplayRole) const override;
     bool setData(const QModelIndex&, const QVariant& value, int role = Qt::EditRole) override;
+    // Children are fetched the first time their parent is expanded
+    bool hasChildren(const QModelIndex& parent = {}) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     QModelIndex appendRow(const AccountFields&, const QModelIndex& parent);
+    // Deletes the accounts on the worker thread, then removes the rows. Failures are reported by
+    // error_occurred() (the rows stay)
     bool removeRows(int row, int count, const QModelIndex& parent) override;
+    /* Renames the account (or level of the hierarchy) to new_path, moving everything below it
+       along with it. Throws sql_helpers::Error if new_path is invalid. The accounts are renamed
+       on the worker thread, and the tree is updated once that is done (if new_path turns out to
+       be taken, error_occurred() is emitted instead) */
+    void move_account(const QModelIndex&, const QString& new_path);
+signals:
+    void error_occurred(QString error_message);
 public slots:
     void load();
+    void load_balances();
 private:
+    // Re-reads the balances of the given accounts on the worker thread, then adjusts the totals
+    // of the levels above each one by its change
+    void reload_balances(std::vector<int> account_ids);
+    void add_to_subtree_balances(const QString& path, qint64 change);
+    void clear();
+    QModelIndex node_index(int node, int column = Name_Column) const;
+    // Removes the rows from the tree only (the accounts are left in the database)
+    void remove_nodes(int row, int count, const QModelIndex& parent);
+    // Moves the node to new_path in the tree only, after its accounts have been renamed
+    void move_node(int node, const QString& new_path);
+
     struct Impl;
     Impl* m_impl;
 };
@@ -16,15 +16,23 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "DatabaseManager.hpp"
-#include <optional>
+#include <mutex>
+#include <utility>
+#include <QByteArray>
 #include <QSqlDatabase>
+#include <QSqlDriver>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
 #include "util/sql_helpers.hpp"
+#if defined(WITH_SQLITE_HOOKS) || defined(SQL_QUERY_LOGGING)
+#include <sqlite3.h>
+#endif
 #ifdef SQL_QUERY_LOGGING
 #include <iostream>
-#include <QSqlDriver>
-#include <sqlite3.h>
 #endif
 
 using namespace Qt::StringLiterals;
@@ -32,16 +40,215 @@ using namespace Qt::StringLiterals;
 struct DatabaseManager::Impl {
     QSqlDatabase db;
     unsigned int db_gen = 0;
+    QThread worker_thread;
+    QObject* worker_context = nullptr;
+    // Only accessed on the worker thread. A newly loaded database is opened as the standby
+    // connection and replaces worker_db once the GUI thread has switched over to it
+    QSqlDatabase worker_db;
+    QSqlDatabase standby_worker_db;
+    // Committed changes that rows_changed() hasn't reported yet. Added to from both threads
+    std::mutex changes_mutex;
+    DatabaseChanges committed_changes;
+    bool report_scheduled = false;
+    // Holds the file backing the current database if it hasn't been saved anywhere
+    std::shared_ptr<QTemporaryDir> scratch_dir;
+    // For connections whose changes are recorded by triggers (see watch_changes()), the GUI
+    // thread's is checked for changes periodically and the worker thread's after each task
+    QTimer gui_changes_poll;
+    bool worker_has_triggers = false;
+};
+
+// What happened to a row. The same values as the operation codes that SQLite's update hook is given
+enum RowOperation {
+    Row_Deleted = 9,
+    Row_Inserted = 18,
+    Row_Updated = 23
 };
 
-static constexpr int latest_schema_version = 1;
+#ifdef WITH_SQLITE_HOOKS
+static_assert(Row_Deleted == SQLITE_DELETE && Row_Inserted == SQLITE_INSERT && Row_Updated == SQLITE_UPDATE);
+
+// Changes made through this thread's connection in the current transaction
+struct UncommittedChanges {
+    DatabaseChanges tables;
+    // Consecutive changes are usually to the same table, so its entry is kept at hand
+    QByteArray last_table;
+    TableChanges* last_changes = nullptr;
+
+    void clear()
+    {
+        tables.clear();
+        last_changes = nullptr;
+    }
+};
+
+static thread_local UncommittedChanges uncommitted_changes;
+#endif
+
+static constexpr int latest_schema_version = 13;
+// How long (in milliseconds) a connection waits for the other connection to finish writing
+static constexpr int busy_timeout = 5000;
+// How often (in milliseconds) the GUI thread's connection is checked for changes it recorded with triggers
+static constexpr int changes_poll_interval = 100;
+
+static
+bool is_in_memory(const QString& database_path)
+{
+    return database_path.isEmpty() || database_path == u":memory:";
+}
+
+static
+void close_connection(QSqlDatabase& db)
+{
+    auto connection_name = db.connectionName();
+    sql_helpers::clear_statement_cache(db);
+    db = {};
+    if(!connection_name.isEmpty()) {
+        QSqlDatabase::removeDatabase(connection_name);
+    }
+}
+
+static
+QSqlDatabase open_connection(const QString& database_path, const QString& connection_name)
+{
+    auto db = QSqlDatabase::addDatabase(u"QSQLITE"_s, connection_name);
+    db.setDatabaseName(database_path);
+    db.setConnectOptions(u"QSQLITE_BUSY_TIMEOUT=%1"_s.arg(busy_timeout));
+    if(!db.open()) {
+        auto error_message = db.lastError().databaseText();
+        if(error_message.isEmpty()) {
+            error_message = u"Failed to open accounts database"_s;
+        }
+        close_connection(db);
+        throw sql_helpers::Error(error_message.toStdString());
+    }
+    QSqlQuery query{db};
+    sql_helpers::exec(query, u"pragma foreign_keys = ON"_s);
+    return db;
+}
+
+#if defined(WITH_SQLITE_HOOKS) || defined(SQL_QUERY_LOGGING)
+/* Whether Qt's SQLite plugin uses the same copy of SQLite as we do. If it bundles its own (as the
+   official Qt builds do), passing its connections to our copy's functions is undefined behavior.
+   Our copy's count of the memory it has allocated only goes up when the plugin runs a query if
+   the plugin is using it (or if that count is disabled, in which case it is assumed not to be) */
+static
+bool shares_sqlite_library(QSqlDatabase& db)
+{
+    static const bool is_shared = [&db] {
+        constexpr int blob_size = 1'000'000;
+        QSqlQuery query{db};
+        query.setForwardOnly(true);
+        auto used_before = sqlite3_memory_used();
+        // The statement holds on to the blob until it is finished
+        if(!query.exec(u"SELECT randomblob(%1)"_s.arg(blob_size)) || !query.next()) {
+            return false;
+        }
+        return sqlite3_memory_used() - used_before >= blob_size;
+    }();
+    return is_shared;
+}
+
+// Returns null if the connection doesn't belong to our copy of SQLite
+static
+sqlite3* sqlite_handle(QSqlDatabase& db)
+{
+    auto v = db.driver()->handle();
+    if(!v.isValid() || qstrcmp(v.typeName(), "sqlite3*") != 0 || !shares_sqlite_library(db)) {
+        return nullptr;
+    }
+    return *static_cast<sqlite3**>(v.data());
+}
+#endif
+
+static
+void enable_query_logging([[maybe_unused]] QSqlDatabase& db)
+{
+    #ifdef SQL_QUERY_LOGGING
+        if(auto* handle = sqlite_handle(db)) {
+            sqlite3_trace_v2(handle, SQLITE_TRACE_STMT, [](unsigned, void*, void* p, void*) {
+                auto* stmt = static_cast<sqlite3_stmt*>(p);
+                auto* stmt_text = sqlite3_expanded_sql(stmt);
+                std::cerr << "SQLITE: " << stmt_text << "\n";
+                sqlite3_free(stmt_text);
+                return 0;
+            }, nullptr);
+        }
+    #endif
+}
+
+// Adds one row change to the changes already seen
+static
+void record_change(TableChanges& changes, int operation, qint64 rowid)
+{
+    switch(operation) {
+        case Row_Inserted:
+            // The rowid of a deleted row was reused
+            if(changes.deleted.erase(rowid) > 0) {
+                changes.updated.insert(rowid);
+            } else {
+                changes.inserted.insert(rowid);
+            }
+            break;
+        case Row_Updated:
+            if(!changes.inserted.contains(rowid)) {
+                changes.updated.insert(rowid);
+            }
+            break;
+        case Row_Deleted:
+            // Rows that were inserted and deleted again since the last report never existed as far
+            // as anyone else knows
+            if(changes.inserted.erase(rowid) == 0) {
+                changes.updated.erase(rowid);
+                changes.deleted.insert(rowid);
+            }
+            break;
+    }
+}
+
+static
+void merge_changes(DatabaseChanges& merged, const DatabaseChanges& later_changes)
+{
+    for(const auto& [table, changes] : later_changes) {
+        auto& merged_table = merged[table];
+        for(auto rowid : changes.deleted) {
+            record_change(merged_table, Row_Deleted, rowid);
+        }
+        for(auto rowid : changes.inserted) {
+            record_change(merged_table, Row_Inserted, rowid);
+        }
+        for(auto rowid : changes.updated) {
+            record_change(merged_table, Row_Updated, rowid);
+        }
+    }
+}
 
 DatabaseManager::DatabaseManager()
     : m_impl(new Impl)
-{}
+{
+    m_impl->worker_context = new QObject;
+    m_impl->worker_context->moveToThread(&m_impl->worker_thread);
+    connect(&m_impl->worker_thread, &QThread::finished, m_impl->worker_context, &QObject::deleteLater);
+    m_impl->worker_thread.start();
+    m_impl->gui_changes_poll.setInterval(changes_poll_interval);
+    connect(&m_impl->gui_changes_poll, &QTimer::timeout, this, [this] {
+        try {
+            report_recorded_changes(m_impl->db);
+        } catch(const sql_helpers::Error& err) {
+            qWarning("Failed to read changes to the database: %s", err.what());
+        }
+    });
+}
 
 DatabaseManager::~DatabaseManager() noexcept
 {
+    QMetaObject::invokeMethod(m_impl->worker_context, [this] {
+        close_connection(m_impl->worker_db);
+        close_connection(m_impl->standby_worker_db);
+    }, Qt::BlockingQueuedConnection);
+    m_impl->worker_thread.quit();
+    m_impl->worker_thread.wait();
+    close_connection(m_impl->db);
     delete m_impl;
 }
 
@@ -50,58 +257,193 @@ QSqlDatabase& DatabaseManager::database()
     return m_impl->db;
 }
 
+QObject* DatabaseManager::worker_context()
+{
+    return m_impl->worker_context;
+}
+
+QSqlDatabase& DatabaseManager::worker_database()
+{
+    return m_impl->worker_db;
+}
+
+bool DatabaseManager::watch_changes(QSqlDatabase& db)
+{
+#ifdef WITH_SQLITE_HOOKS
+    if(auto* handle = sqlite_handle(db)) {
+        // The hooks run on the thread using the connection, in the middle of executing a
+        // statement, so they only record the changes. Note that the commit hook runs just before
+        // the commit happens, so a commit that then fails (which is rare) still has its changes
+        // reported
+        sqlite3_update_hook(handle, [](void*, int operation, const char*, const char* table, sqlite3_int64 rowid) {
+            auto& pending = uncommitted_changes;
+            if(!pending.last_changes || pending.last_table != table) {
+                pending.last_table = table;
+                pending.last_changes = &pending.tables[QString::fromUtf8(table)];
+            }
+            record_change(*pending.last_changes, operation, rowid);
+        }, nullptr);
+        sqlite3_commit_hook(handle, [](void* db_manager) {
+            auto& pending = uncommitted_changes;
+            if(!pending.tables.empty()) {
+                static_cast<DatabaseManager*>(db_manager)->report_changes(pending.tables);
+            }
+            pending.clear();
+            return 0;
+        }, this);
+        sqlite3_rollback_hook(handle, [](void*) {
+            uncommitted_changes.clear();
+        }, nullptr);
+        return true;
+    }
+#endif
+    // Temporary triggers only fire for this connection's own changes, and are rolled back along
+    // with them. Like the update hook, they skip WITHOUT ROWID tables
+    QSqlQuery query{db};
+    sql_helpers::exec(query, u"CREATE TEMP TABLE changed_rows(table_name TEXT NOT NULL, operation INTEGER NOT NULL,"
+                              " row_id INTEGER NOT NULL)"_s);
+    sql_helpers::exec(query, u"SELECT name FROM sqlite_schema WHERE type = 'table' AND name NOT LIKE 'sqlite_%'"
+                              " AND sql NOT LIKE '%WITHOUT ROWID%'"_s);
+    QStringList tables;
+    while(query.next()) {
+        tables.append(query.value(0).toString());
+    }
+    query.finish();
+    static const struct {
+        QString event;
+        RowOperation operation;
+        QString row;
+    } events[] = {
+        {u"INSERT"_s, Row_Inserted, u"new"_s}, {u"UPDATE"_s, Row_Updated, u"new"_s}, {u"DELETE"_s, Row_Deleted, u"old"_s}
+    };
+    for(const auto& table : tables) {
+        for(const auto& [event, operation, row] : events) {
+            sql_helpers::exec(query, u"CREATE TEMP TRIGGER \"record_%1_%2\" AFTER %2 ON main.\"%1\""
+                                      " BEGIN INSERT INTO changed_rows VALUES ('%1', %3, %4.rowid); END"_s
+                                      .arg(table, event).arg(static_cast<int>(operation)).arg(row));
+        }
+    }
+    return false;
+}
+
+void DatabaseManager::report_recorded_changes(QSqlDatabase& db)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT table_name, operation, row_id FROM temp.changed_rows ORDER BY rowid"_s);
+    sql_helpers::exec(query);
+    DatabaseChanges changes;
+    while(query.next()) {
+        record_change(changes[query.value(0).toString()], query.value(1).toInt(), query.value(2).toLongLong());
+    }
+    query.finish();
+    if(changes.empty()) {
+        return;
+    }
+    auto& delete_query = sql_helpers::prepared(db, u"DELETE FROM temp.changed_rows"_s);
+    sql_helpers::exec(delete_query);
+    delete_query.finish();
+    report_changes(changes);
+}
+
+void DatabaseManager::report_worker_changes() noexcept
+{
+    if(!m_impl->worker_has_triggers) {
+        return;
+    }
+    try {
+        report_recorded_changes(m_impl->worker_db);
+    } catch(const sql_helpers::Error& err) {
+        qWarning("Failed to read changes to the database: %s", err.what());
+    }
+}
+
+void DatabaseManager::report_changes(const DatabaseChanges& changes)
+{
+    std::scoped_lock lock{m_impl->changes_mutex};
+    merge_changes(m_impl->committed_changes, changes);
+    if(m_impl->report_scheduled) {
+        return;
+    }
+    m_impl->report_scheduled = true;
+    // Anything committed before this runs is reported along with these changes
+    QMetaObject::invokeMethod(this, [this] {
+        DatabaseChanges changes;
+        {
+            std::scoped_lock lock{m_impl->changes_mutex};
+            changes = std::exchange(m_impl->committed_changes, {});
+            m_impl->report_scheduled = false;
+        }
+        if(!changes.empty()) {
+            emit rows_changed(changes);
+        }
+    }, Qt::QueuedConnection);
+}
+
 void DatabaseManager::load_database(QString database_path)
 {
-    auto db_name = QString::number(m_impl->db_gen++);
-    auto standby_db = QSqlDatabase::addDatabase(u"QSQLITE"_s, db_name);
-    standby_db.setDatabaseName(database_path);
-    std::optional<QString> error_message;
-    if(!standby_db.open()) {
-        error_message = standby_db.lastError().databaseText();
-        if(error_message->isEmpty()) {
-            error_message = u"Failed to open accounts database"_s;
+    auto db_gen = m_impl->db_gen++;
+    // An in-memory database can only be shared between the two connections through SQLite's
+    // shared cache, whose table locks make reads fail (instead of wait) while the other
+    // connection writes. So an unsaved database lives in a temporary file instead
+    std::shared_ptr<QTemporaryDir> scratch_dir;
+    auto file_path = database_path;
+    if(is_in_memory(database_path)) {
+        scratch_dir = std::make_shared<QTemporaryDir>();
+        file_path = scratch_dir->filePath(u"unsaved.qaccountant"_s);
+    }
+    // The schema migration (the slow part) happens on the worker thread. The GUI thread's
+    // connection is only opened once that has succeeded
+    run_async([this, database_path, file_path, scratch_dir, db_gen](QSqlDatabase&) {
+        if(scratch_dir && !scratch_dir->isValid()) {
+            throw sql_helpers::Error(u"Failed to create a temporary database\n(Reason: %1)"_s
+                                     .arg(scratch_dir->errorString()).toStdString());
         }
-    } else {
+        auto& standby_db = m_impl->standby_worker_db;
+        standby_db = open_connection(file_path, u"worker-%1"_s.arg(db_gen));
         try {
             QSqlQuery query{standby_db};
-            sql_helpers::exec(query, u"pragma foreign_keys = ON"_s);
+            // Lets the GUI thread keep reading while the worker thread writes
+            sql_helpers::exec(query, u"pragma journal_mode = WAL"_s);
             sql_helpers::upgrade_schema_if_needed(standby_db, latest_schema_version, u":/qaccountant/schemas"_s);
         } catch(const sql_helpers::Error& err) {
             // For some reason, Qt does not check if the SQLite database that it opened is actually
             // a valid database file, so we do not find out until attempting to execute the first
             // query (which will then throw an exception)
-            error_message = u"Failed to read '%1'\n(Reason: %2)"_s.arg(database_path, err.what());
+            close_connection(standby_db);
+            throw sql_helpers::Error(u"Failed to read '%1'\n(Reason: %2)"_s.arg(database_path, err.what()).toStdString());
         }
-    }
-
-    if(error_message.has_value()) {
-        standby_db = {};
-        QSqlDatabase::removeDatabase(db_name);
-        emit failed_to_load_database(*error_message);
-    } else {
+    }).then(this, [this, file_path, scratch_dir, db_gen] {
+        auto standby_db = open_connection(file_path, QString::number(db_gen));
         if(m_impl->db.isOpen()) {
-            auto old_db_name = m_impl->db.connectionName();
             // Notify models so that they can close their queries
             emit database_closing();
-            m_impl->db = {};
-            QSqlDatabase::removeDatabase(old_db_name);
+            close_connection(m_impl->db);
         }
         m_impl->db = standby_db;
-        #ifdef SQL_QUERY_LOGGING
-            auto v = m_impl->db.driver()->handle();
-            if(v.isValid()) {
-                auto* sqlite_handle = *static_cast<sqlite3**>(v.data());
-                if(sqlite_handle) {
-                    sqlite3_trace_v2(sqlite_handle, SQLITE_TRACE_STMT, [](unsigned, void*, void* p, void*) {
-                        auto* stmt = static_cast<sqlite3_stmt*>(p);
-                        auto* stmt_text = sqlite3_expanded_sql(stmt);
-                        std::cerr << "SQLITE: " << stmt_text << "\n";
-                        sqlite3_free(stmt_text);
-                        return 0;
-                    }, nullptr);
-                }
-            }
-        #endif
+        enable_query_logging(m_impl->db);
+        if(watch_changes(m_impl->db)) {
+            m_impl->gui_changes_poll.stop();
+        } else {
+            m_impl->gui_changes_poll.start();
+        }
+        {
+            // Changes to the old database are of no use to anyone now
+            std::scoped_lock lock{m_impl->changes_mutex};
+            m_impl->committed_changes.clear();
+        }
+        // Any tasks queued before this one still run against the old database, so its file (if
+        // it had one) is only deleted once the worker thread has closed it
+        run_async([this, old_scratch_dir = std::exchange(m_impl->scratch_dir, scratch_dir)](QSqlDatabase& worker_db) {
+            m_impl->worker_has_triggers = false;
+            close_connection(worker_db);
+            worker_db = std::exchange(m_impl->standby_worker_db, {});
+            enable_query_logging(worker_db);
+            m_impl->worker_has_triggers = !watch_changes(worker_db);
+        });
         emit database_loaded();
-    }
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        run_async([this](QSqlDatabase&) {
+            close_connection(m_impl->standby_worker_db);
+        });
+        emit failed_to_load_database(QString::fromStdString(err.what()));
+    });
 }
@@ -17,26 +17,102 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <QFuture>
 #include <QObject>
+#include <QPromise>
 #include <QString>
 
 QT_BEGIN_NAMESPACE
 class QSqlDatabase;
 QT_END_NAMESPACE
 
+// Rows (by rowid) of one table that were inserted, updated, or deleted. A row is only ever in one
+// of the sets: e.g. a row that was inserted and then updated is just in inserted
+struct TableChanges {
+    std::unordered_set<qint64> inserted;
+    std::unordered_set<qint64> updated;
+    std::unordered_set<qint64> deleted;
+
+    bool contains(qint64 rowid) const
+    {
+        return inserted.contains(rowid) || updated.contains(rowid) || deleted.contains(rowid);
+    }
+};
+
+// Changed rows, keyed by table name
+using DatabaseChanges = std::unordered_map<QString, TableChanges>;
+Q_DECLARE_METATYPE(DatabaseChanges);
+
+/* Owns the database connections. database() is the connection used on the GUI thread; anything
+   slow (opening/migrating a database, loading the account tree, submitting changes) should
+   instead be passed to run_async(), which runs it on a worker thread that has its own connection
+   to the same database. Changes committed through either connection are reported by rows_changed() */
 class DatabaseManager : public QObject {
     Q_OBJECT
 public:
     DatabaseManager();
     ~DatabaseManager() noexcept;
     QSqlDatabase& database();
+
+    // Runs task(worker_db) on the worker thread. Tasks run one at a time, in the order they were
+    // submitted. Any exception thrown by the task is stored in the returned future
+    template<typename Task>
+    auto run_async(Task task) -> QFuture<std::invoke_result_t<Task&, QSqlDatabase&>>;
 signals:
     void database_closing();
     void database_loaded();
     void failed_to_load_database(QString error_message);
+    // Emitted on the GUI thread after changes have been committed. Changes from commits made
+    // in quick succession are merged into a single signal
+    void rows_changed(const DatabaseChanges&);
 public slots:
     void load_database(QString database_path);
 private:
+    QObject* worker_context();
+    // Only usable from the worker thread
+    QSqlDatabase& worker_database();
+    /* Registers the hooks that report the changes committed through a connection. If SQLite
+       can't be called directly (see shares_sqlite_library()), creates triggers that record them
+       instead and returns false, in which case report_recorded_changes() has to be called after
+       the connection writes */
+    bool watch_changes(QSqlDatabase&);
+    // Reports and clears the changes recorded by the connection's triggers. Must not be called
+    // in the middle of a transaction
+    void report_recorded_changes(QSqlDatabase&);
+    // Called on the worker thread after each task
+    void report_worker_changes() noexcept;
+    // Called (on either thread) when a connection commits
+    void report_changes(const DatabaseChanges&);
+
     struct Impl;
     Impl* m_impl;
 };
+
+template<typename Task>
+auto DatabaseManager::run_async(Task task) -> QFuture<std::invoke_result_t<Task&, QSqlDatabase&>>
+{
+    using Result = std::invoke_result_t<Task&, QSqlDatabase&>;
+    auto promise = std::make_shared<QPromise<Result>>();
+    auto future = promise->future();
+    promise->start();
+    QMetaObject::invokeMethod(worker_context(), [this, promise, task = std::move(task)]() mutable {
+        try {
+            if constexpr(std::is_void_v<Result>) {
+                task(worker_database());
+            } else {
+                promise->addResult(task(worker_database()));
+            }
+        } catch(...) {
+            promise->setException(std::current_exception());
+        }
+        // Reported before anyone waiting on the task can find out that it finished
+        report_worker_changes();
+        promise->finish();
+    }, Qt::QueuedConnection);
+    return future;
+}
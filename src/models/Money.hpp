@@ -0,0 +1,111 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <compare>
+#include <QChar>
+#include <QString>
+
+/* Amounts are stored in the database as INTEGER counts of fixed fractions of a unit (e.g. cents)
+   so that sums over them are exact. These helpers convert between that representation and the
+   decimal form shown to the user */
+
+constexpr int decimal_places(qint64 scale)
+{
+    int places = 0;
+    for(; scale > 1; scale /= 10) {
+        ++places;
+    }
+    return places;
+}
+
+inline
+qint64 fixed_point_from_double(double value, qint64 scale)
+{
+    return std::llround(value * static_cast<double>(scale));
+}
+
+inline
+double fixed_point_to_double(qint64 units, qint64 scale)
+{
+    return static_cast<double>(units) / static_cast<double>(scale);
+}
+
+// Exact decimal text, e.g. 12345 with a scale of 100 is "123.45"
+inline
+QString fixed_point_text(qint64 units, qint64 scale)
+{
+    auto magnitude = units < 0 ? 0 - static_cast<quint64>(units) : static_cast<quint64>(units);
+    auto unsigned_scale = static_cast<quint64>(scale);
+    QString text;
+    if(units < 0) {
+        text += QLatin1Char('-');
+    }
+    text += QString::number(magnitude / unsigned_scale);
+    if(auto places = decimal_places(scale); places > 0) {
+        text += QLatin1Char('.');
+        text += QString::number(magnitude % unsigned_scale).rightJustified(places, QLatin1Char('0'));
+    }
+    return text;
+}
+
+template<typename Tag, qint64 Scale>
+class FixedPoint {
+public:
+    static constexpr qint64 scale = Scale;
+    static constexpr int decimals = decimal_places(Scale);
+
+    constexpr FixedPoint() = default;
+
+    static constexpr
+    FixedPoint from_units(qint64 units)
+    {
+        FixedPoint value;
+        value.m_units = units;
+        return value;
+    }
+
+    static
+    FixedPoint from_double(double value) { return from_units(fixed_point_from_double(value, Scale)); }
+
+    constexpr qint64 units() const { return m_units; }
+    double to_double() const { return fixed_point_to_double(m_units, Scale); }
+    QString to_string() const { return fixed_point_text(m_units, Scale); }
+
+    constexpr FixedPoint& operator+=(FixedPoint other) { m_units += other.m_units; return *this; }
+    constexpr FixedPoint& operator-=(FixedPoint other) { m_units -= other.m_units; return *this; }
+    constexpr FixedPoint operator-() const { return from_units(-m_units); }
+    friend constexpr FixedPoint operator+(FixedPoint a, FixedPoint b) { return a += b; }
+    friend constexpr FixedPoint operator-(FixedPoint a, FixedPoint b) { return a -= b; }
+    friend constexpr auto operator<=>(FixedPoint, FixedPoint) = default;
+private:
+    qint64 m_units = 0;
+};
+
+struct MoneyTag;
+struct PriceTag;
+struct QuantityTag;
+
+// Cash amounts, in cents
+using Money = FixedPoint<MoneyTag, 100>;
+// Price of one unit of a security, in 1/10000ths of a dollar
+using Price = FixedPoint<PriceTag, 10'000>;
+// Number of units of a security, in 1/10000ths of a unit
+using Quantity = FixedPoint<QuantityTag, 10'000>;
@@ -24,4 +24,10 @@ enum Role {
     Account_ID_Role = Qt::UserRole + 1,
     Account_Path_Role,
     Account_Kind_Role,
+    // Number of decimal places that a fixed-point amount is stored with
+    Decimal_Places_Role,
+    // Current balance of an account, in cents
+    Account_Balance_Role,
+    // Whether a transaction row is marked to be deleted by the next submit
+    Pending_Delete_Role,
 };
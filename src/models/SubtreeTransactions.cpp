@@ -0,0 +1,726 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SubtreeTransactions.hpp"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <QDate>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include "AccountDirectory.hpp"
+#include "DatabaseManager.hpp"
+#include "Money.hpp"
+#include "util/sql_helpers.hpp"
+
+using namespace Qt::StringLiterals;
+
+// Number of rows requested from the database each time the view scrolls past the end of the
+// rows fetched so far
+static constexpr int page_size = 256;
+// The descriptions and accounts of at most this many pages of rows are kept in memory. The rest
+// are read again (by ID) when they are scrolled back into view
+static constexpr size_t max_resident_pages = 16;
+// Changes to more rows than this at once (e.g. from an import) are merged in with one reset of
+// the view instead of being moved into place one at a time
+static constexpr size_t max_placed_rows = page_size;
+// Subtrees with up to this many accounts are read by merging each account's postings. Larger ones
+// are read in date order across the whole ledger (see read_rows_after())
+static constexpr size_t max_merged_accounts = 32;
+
+namespace {
+
+// Position of a row in the (date, id) order that transactions are shown in
+struct RowKey {
+    qint64 date; // Julian day
+    qint64 id;
+
+    friend auto operator<=>(const RowKey&, const RowKey&) = default;
+};
+
+// The columns of a row that aren't needed for ordering it or for the running balance
+struct RowDetails {
+    QString description;
+    int source = 0;
+    int destination = 0;
+};
+
+// A transaction that involves the subtree, as stored. change is the sum of its legs in the subtree
+struct StoredRow {
+    RowKey key;
+    qint64 change;
+    RowDetails details;
+};
+
+// What the worker thread reads back after other views have changed transactions
+struct ChangedRows {
+    // Only the changed transactions that still involve the subtree
+    std::vector<StoredRow> stored_rows;
+    qint64 balance = 0;
+};
+
+} // namespace
+
+// IDs of every account in the subtree
+static
+std::vector<int> read_subtree_accounts(const QSqlDatabase& db, const QString& path)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT account_id FROM account_closure WHERE ancestor = ?"_s);
+    query.addBindValue(path);
+    sql_helpers::exec(query);
+    std::vector<int> account_ids;
+    while(query.next()) {
+        account_ids.push_back(query.value(0).toInt());
+    }
+    query.finish();
+    return account_ids;
+}
+
+// Sum of the current balances of every account in the subtree
+static
+qint64 read_balance(const QSqlDatabase& db, const QString& path)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT coalesce(sum(b.balance), 0) FROM account_closure a"
+                                             " JOIN account_balances b ON b.account_id = a.account_id"
+                                             " WHERE a.ancestor = ?"_s);
+    query.addBindValue(path);
+    sql_helpers::exec(query);
+    sql_helpers::next(query);
+    auto balance = query.value(0).toLongLong();
+    query.finish();
+    return balance;
+}
+
+/* Reads the first row_limit transactions after the given key from a few accounts. Each account's
+   postings are one range of the postings primary key, already in (date, id) order, so the
+   accounts' next row_limit postings are read and merged. Every transaction has at most one posting
+   per account, so that covers every leg of the first row_limit transactions, and no more than
+   row_limit rows are read per account however much of the ledger comes after the key. A
+   transaction's change is the sum of its legs in the subtree, so it is positive when money moves
+   into the subtree from outside of it and zero when it moves within the subtree */
+static
+std::vector<std::pair<RowKey, qint64>> read_account_rows_after(const QSqlDatabase& db, const std::vector<int>& account_ids,
+                                                               RowKey after, int row_limit)
+{
+    struct Posting {
+        RowKey key;
+        qint64 amount;
+    };
+    std::vector<std::vector<Posting>> runs;
+    auto& query = sql_helpers::prepared(db, u"SELECT date, transaction_id, amount FROM postings"
+                                             " WHERE account_id = ? AND (date, transaction_id) > (?, ?)"
+                                             " ORDER BY date, transaction_id LIMIT ?"_s);
+    for(auto account_id : account_ids) {
+        query.addBindValue(account_id);
+        query.addBindValue(after.date);
+        query.addBindValue(after.id);
+        query.addBindValue(row_limit);
+        sql_helpers::exec(query);
+        std::vector<Posting> run;
+        while(query.next()) {
+            run.push_back({{query.value(0).toLongLong(), query.value(1).toLongLong()}, query.value(2).toLongLong()});
+        }
+        query.finish();
+        if(!run.empty()) {
+            runs.push_back(std::move(run));
+        }
+    }
+
+    // Heads of the runs, smallest key first
+    using Head = std::pair<RowKey, size_t>; // Key and run number
+    std::vector<size_t> offsets(runs.size(), 0);
+    std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+    for(size_t run_num = 0; run_num < runs.size(); ++run_num) {
+        heads.emplace(runs[run_num].front().key, run_num);
+    }
+    std::vector<std::pair<RowKey, qint64>> rows;
+    while(!heads.empty()) {
+        auto [key, run_num] = heads.top();
+        heads.pop();
+        const auto& run = runs[run_num];
+        auto amount = run[offsets[run_num]].amount;
+        if(!rows.empty() && rows.back().first == key) {
+            rows.back().second += amount;
+        } else if(rows.size() == static_cast<size_t>(row_limit)) {
+            break;
+        } else {
+            rows.emplace_back(key, amount);
+        }
+        if(++offsets[run_num] < run.size()) {
+            heads.emplace(run[offsets[run_num]].key, run_num);
+        }
+    }
+    return rows;
+}
+
+/* Reads the first row_limit transactions after the given key from a large subtree, with one query
+   that walks every posting in (date, id) order and checks whether its account is in the subtree.
+   The legs of a transaction are next to each other in that order, so they are summed without
+   sorting, and the query stops once it has row_limit transactions. How far it has to walk depends
+   on the share of the ledger that the subtree has, which is large for the levels that have this
+   many accounts */
+static
+std::vector<std::pair<RowKey, qint64>> read_subtree_rows_after(const QSqlDatabase& db, const QString& path, RowKey after,
+                                                               int row_limit)
+{
+    auto& query = sql_helpers::prepared(db, u"SELECT p.date, p.transaction_id, sum(p.amount)"
+                                             " FROM postings p INDEXED BY postings_date"
+                                             " CROSS JOIN account_closure a ON a.ancestor = ? AND a.account_id = p.account_id"
+                                             " WHERE (p.date, p.transaction_id) > (?, ?)"
+                                             " GROUP BY p.date, p.transaction_id ORDER BY p.date, p.transaction_id LIMIT ?"_s);
+    query.addBindValue(path);
+    query.addBindValue(after.date);
+    query.addBindValue(after.id);
+    query.addBindValue(row_limit);
+    sql_helpers::exec(query);
+    std::vector<std::pair<RowKey, qint64>> rows;
+    while(query.next()) {
+        rows.emplace_back(RowKey{query.value(0).toLongLong(), query.value(1).toLongLong()}, query.value(2).toLongLong());
+    }
+    query.finish();
+    return rows;
+}
+
+// Reads the descriptions and accounts of the given transactions
+static
+std::unordered_map<qint64, RowDetails> read_details(const QSqlDatabase& db, const std::vector<qint64>& ids)
+{
+    std::unordered_map<qint64, RowDetails> details;
+    sql_helpers::exec_batched(db, ids.size(), 1, [](size_t count) {
+        return u"SELECT id, description, source, destination FROM transactions WHERE id IN (%1)"_s
+               .arg(QStringList(static_cast<qsizetype>(count), u"?"_s).join(u", "));
+    }, [&ids](QSqlQuery& query, size_t i) {
+        query.addBindValue(ids[i]);
+    }, [&details](QSqlQuery& query) {
+        while(query.next()) {
+            details.emplace(query.value(0).toLongLong(),
+                            RowDetails{query.value(1).toString(), query.value(2).toInt(), query.value(3).toInt()});
+        }
+    });
+    return details;
+}
+
+// Runs on the database worker thread. Reads the given transactions (through the index on their
+// postings), skipping any that no longer involve the subtree, along with its balance
+static
+ChangedRows read_changed_rows(QSqlDatabase& db, const QString& path, const std::vector<qint64>& ids)
+{
+    auto subtree_accounts = read_subtree_accounts(db, path);
+    std::unordered_set<int> account_ids(subtree_accounts.begin(), subtree_accounts.end());
+    std::unordered_map<qint64, StoredRow> rows_by_id;
+    std::unordered_set<qint64> involved_ids;
+    sql_helpers::exec_batched(db, ids.size(), 1, [](size_t count) {
+        return u"SELECT t.id, t.date, t.description, t.source, t.destination, p.account_id, p.amount"
+                " FROM transactions t JOIN postings p INDEXED BY postings_transaction_id ON p.transaction_id = t.id"
+                " WHERE t.id IN (%1)"_s
+               .arg(QStringList(static_cast<qsizetype>(count), u"?"_s).join(u", "));
+    }, [&ids](QSqlQuery& query, size_t i) {
+        query.addBindValue(ids[i]);
+    }, [&](QSqlQuery& query) {
+        while(query.next()) {
+            auto id = query.value(0).toLongLong();
+            auto it = rows_by_id.find(id);
+            if(it == rows_by_id.end()) {
+                it = rows_by_id.emplace(id, StoredRow{
+                    {query.value(1).toLongLong(), id}, 0,
+                    {query.value(2).toString(), query.value(3).toInt(), query.value(4).toInt()}
+                }).first;
+            }
+            if(account_ids.contains(query.value(5).toInt())) {
+                it->second.change += query.value(6).toLongLong();
+                involved_ids.insert(id);
+            }
+        }
+    });
+    ChangedRows result;
+    for(auto& [id, stored_row] : rows_by_id) {
+        if(involved_ids.contains(id)) {
+            result.stored_rows.push_back(std::move(stored_row));
+        }
+    }
+    result.balance = read_balance(db, path);
+    return result;
+}
+
+struct SubtreeTransactions::Impl {
+    // Reads up to row_limit rows after the last fetched row
+    std::vector<std::pair<RowKey, qint64>> fetch_rows(int row_limit)
+    {
+        auto after = keys.empty() ? RowKey{std::numeric_limits<qint64>::min(), 0} : keys.back();
+        if(!account_ids) {
+            account_ids = read_subtree_accounts(db, path);
+        }
+        auto fetched = account_ids->size() <= max_merged_accounts
+            ? read_account_rows_after(db, *account_ids, after, row_limit)
+            : read_subtree_rows_after(db, path, after, row_limit);
+        if(fetched.size() < static_cast<size_t>(row_limit)) {
+            fetched_all = true;
+        }
+        return fetched;
+    }
+
+    void append_rows(const std::vector<std::pair<RowKey, qint64>>& fetched)
+    {
+        auto balance = balances.empty() ? 0 : balances.back();
+        for(const auto& [key, change] : fetched) {
+            balance += change;
+            keys.push_back(key);
+            changes.push_back(change);
+            balances.push_back(balance);
+        }
+    }
+
+    // Returns the details of a fetched row, reading them (along with the rest of its page) if
+    // they aren't in memory
+    const RowDetails& row_details(int row_num)
+    {
+        auto id = keys[row_num].id;
+        if(auto it = details.constFind(id); it != details.constEnd()) {
+            return *it;
+        }
+        auto first = row_num - row_num % page_size;
+        auto last = std::min(first + page_size, static_cast<int>(keys.size()));
+        std::vector<qint64> page_ids;
+        for(auto row = first; row < last; ++row) {
+            if(!details.contains(keys[row].id)) {
+                page_ids.push_back(keys[row].id);
+            }
+        }
+        std::unordered_map<qint64, RowDetails> read;
+        try {
+            read = read_details(db, page_ids);
+        } catch(const sql_helpers::Error& err) {
+            last_error = QString::fromStdString(err.what());
+        }
+        // Older pages are dropped first, since they may list some of the same rows
+        make_resident(page_ids);
+        for(auto page_id : page_ids) {
+            // Rows deleted since they were fetched are shown blank until the change is applied
+            auto it = read.find(page_id);
+            details.insert(page_id, it == read.end() ? RowDetails{} : std::move(it->second));
+        }
+        return details[id];
+    }
+
+    // Records that the details of the given rows are in memory, dropping the details of the
+    // least recently read pages if there are too many
+    void make_resident(std::vector<qint64> ids)
+    {
+        resident_pages.push_back(std::move(ids));
+        while(resident_pages.size() > max_resident_pages) {
+            for(auto id : resident_pages.front()) {
+                details.remove(id);
+            }
+            resident_pages.pop_front();
+        }
+    }
+
+    // Whether a row with the given key belongs among the rows fetched so far
+    bool in_fetched_range(RowKey key) const
+    {
+        return fetched_all || (!keys.empty() && key <= keys.back());
+    }
+
+    int lower_bound(RowKey key) const
+    {
+        return static_cast<int>(std::ranges::lower_bound(keys, key) - keys.begin());
+    }
+
+    void insert_row(int row_num, const StoredRow& stored_row)
+    {
+        keys.insert(keys.begin() + row_num, stored_row.key);
+        changes.insert(changes.begin() + row_num, stored_row.change);
+        balances.insert(balances.begin() + row_num, 0);
+    }
+
+    void erase_row(int row_num)
+    {
+        keys.erase(keys.begin() + row_num);
+        changes.erase(changes.begin() + row_num);
+        balances.erase(balances.begin() + row_num);
+    }
+
+    // Carries the running balance forward from the given row
+    void update_balances(int first_row)
+    {
+        auto balance = first_row == 0 ? 0 : balances[first_row - 1];
+        for(auto row = static_cast<size_t>(first_row); row < keys.size(); ++row) {
+            balance += changes[row];
+            balances[row] = balance;
+        }
+    }
+
+    /* Moves a fetched row (with old_key, if it was fetched) to where its stored values (if it
+       still involves the subtree) place it among the fetched rows, or removes it if they place it
+       past them. The view is told about the change, and first_changed_row is lowered to the first
+       row whose running balance is affected */
+    void place_row(SubtreeTransactions& model, std::optional<RowKey> old_key, const StoredRow* stored_row,
+                   int& first_changed_row)
+    {
+        auto keep = stored_row && in_fetched_range(stored_row->key);
+        if(!old_key) {
+            if(keep) {
+                auto row_num = lower_bound(stored_row->key);
+                model.beginInsertRows({}, row_num, row_num);
+                insert_row(row_num, *stored_row);
+                model.endInsertRows();
+                first_changed_row = std::min(first_changed_row, row_num);
+            }
+            return;
+        }
+        auto old_row = lower_bound(*old_key);
+        first_changed_row = std::min(first_changed_row, old_row);
+        if(!keep) {
+            model.beginRemoveRows({}, old_row, old_row);
+            erase_row(old_row);
+            model.endRemoveRows();
+            return;
+        }
+        // The row number it will have once it is taken out of its old position
+        auto new_row = lower_bound(stored_row->key);
+        if(new_row > old_row) {
+            --new_row;
+        }
+        first_changed_row = std::min(first_changed_row, new_row);
+        if(new_row == old_row) {
+            erase_row(old_row);
+            insert_row(new_row, *stored_row);
+            emit model.dataChanged(model.index(old_row, 0), model.index(old_row, Column_Count - 1));
+        } else {
+            model.beginMoveRows({}, old_row, old_row, {}, new_row > old_row ? new_row + 1 : new_row);
+            erase_row(old_row);
+            insert_row(new_row, *stored_row);
+            model.endMoveRows();
+        }
+    }
+
+    // Merges many changed rows in with one pass over the fetched rows. The view is reset
+    void merge_rows(SubtreeTransactions& model, const std::unordered_set<qint64>& ids,
+                    const std::vector<const StoredRow*>& stored_rows)
+    {
+        model.beginResetModel();
+        std::vector<std::pair<RowKey, qint64>> rows;
+        rows.reserve(keys.size() + stored_rows.size());
+        for(size_t row = 0; row < keys.size(); ++row) {
+            if(!ids.contains(keys[row].id)) {
+                rows.emplace_back(keys[row], changes[row]);
+            }
+        }
+        auto kept_count = rows.size();
+        for(const auto* stored_row : stored_rows) {
+            rows.emplace_back(stored_row->key, stored_row->change);
+        }
+        std::ranges::sort(rows.begin() + static_cast<std::ptrdiff_t>(kept_count), rows.end());
+        std::ranges::inplace_merge(rows, rows.begin() + static_cast<std::ptrdiff_t>(kept_count));
+        keys.clear();
+        changes.clear();
+        balances.clear();
+        append_rows(rows);
+        model.endResetModel();
+    }
+
+    // Updates the fetched rows to match transactions that were changed by someone else
+    void apply_changes(SubtreeTransactions& model, const std::vector<qint64>& ids, const ChangedRows& result)
+    {
+        std::unordered_set<qint64> changed_ids(ids.begin(), ids.end());
+        for(auto id : ids) {
+            details.remove(id);
+        }
+        // Rows that now fall past the fetched rows are left to be fetched along with their neighbours
+        std::vector<const StoredRow*> kept_rows;
+        for(const auto& stored_row : result.stored_rows) {
+            if(in_fetched_range(stored_row.key)) {
+                kept_rows.push_back(&stored_row);
+            }
+        }
+        if(ids.size() > max_placed_rows) {
+            merge_rows(model, changed_ids, kept_rows);
+        } else {
+            // Where the changed rows were, found with one pass over the keys of the fetched rows
+            std::unordered_map<qint64, RowKey> old_keys;
+            for(const auto& key : keys) {
+                if(changed_ids.contains(key.id)) {
+                    old_keys.emplace(key.id, key);
+                }
+            }
+            std::unordered_map<qint64, const StoredRow*> rows_by_id;
+            for(const auto& stored_row : result.stored_rows) {
+                rows_by_id.emplace(stored_row.key.id, &stored_row);
+            }
+            auto first_changed_row = static_cast<int>(keys.size());
+            for(auto id : ids) {
+                std::optional<RowKey> old_key;
+                if(auto it = old_keys.find(id); it != old_keys.end()) {
+                    old_key = it->second;
+                }
+                auto it = rows_by_id.find(id);
+                place_row(model, old_key, it == rows_by_id.end() ? nullptr : it->second, first_changed_row);
+            }
+            if(first_changed_row < static_cast<int>(keys.size())) {
+                update_balances(first_changed_row);
+                emit model.dataChanged(model.index(first_changed_row, Balance_Column),
+                                       model.index(static_cast<int>(keys.size()) - 1, Balance_Column));
+            }
+        }
+        // The changed rows' details are already here, so they don't have to be read again
+        std::vector<qint64> resident_ids;
+        for(const auto* stored_row : kept_rows) {
+            resident_ids.push_back(stored_row->key.id);
+        }
+        if(!resident_ids.empty()) {
+            make_resident(std::move(resident_ids));
+        }
+        for(const auto* stored_row : kept_rows) {
+            details.insert(stored_row->key.id, stored_row->details);
+        }
+    }
+
+    DatabaseManager* db_manager;
+    // The GUI thread's connection, used for fetching pages
+    QSqlDatabase db;
+    const AccountDirectory* account_directory;
+    QString path;
+    qint64 balance = 0;
+    bool fetched_all = false;
+    QString last_error;
+    // The accounts in the subtree, read the first time a page is (and again after accounts change)
+    std::optional<std::vector<int>> account_ids;
+    // Every fetched row's key, change to the subtree's balance, and running balance. The other
+    // columns are kept only for the pages in resident_pages
+    std::vector<RowKey> keys;
+    std::vector<qint64> changes;
+    std::vector<qint64> balances;
+    QHash<qint64, RowDetails> details;
+    // IDs of the rows whose details were read together, least recently read first
+    std::deque<std::vector<qint64>> resident_pages;
+    // IDs of transactions changed by other views (or connections) that haven't been applied yet,
+    // and whether they are being read
+    std::unordered_set<qint64> changed_ids;
+    bool refreshing = false;
+};
+
+SubtreeTransactions::SubtreeTransactions(DatabaseManager& db_manager, const AccountDirectory& account_directory,
+                                         const QString& path)
+    : QAbstractTableModel(), m_impl(new Impl{&db_manager, db_manager.database(), &account_directory, path})
+{
+    try {
+        m_impl->balance = read_balance(m_impl->db, path);
+    } catch(const sql_helpers::Error& err) {
+        m_impl->last_error = QString::fromStdString(err.what());
+    }
+    connect(&db_manager, &DatabaseManager::rows_changed, this, [this](const DatabaseChanges& changes) {
+        if(auto it = changes.find(u"accounts"_s); it != changes.end()) {
+            m_impl->account_ids.reset();
+            // Renamed or deleted accounts can move transactions in or out of the subtree. New
+            // accounts have no transactions yet
+            if(!it->second.updated.empty() || !it->second.deleted.empty()) {
+                reload();
+                return;
+            }
+        }
+        // The amount tables are keyed by transaction ID
+        for(const auto& table : {u"transactions"_s, u"cash_transactions"_s, u"security_transactions"_s}) {
+            if(auto it = changes.find(table); it != changes.end()) {
+                const auto& [inserted, updated, deleted] = it->second;
+                m_impl->changed_ids.insert(inserted.begin(), inserted.end());
+                m_impl->changed_ids.insert(updated.begin(), updated.end());
+                m_impl->changed_ids.insert(deleted.begin(), deleted.end());
+            }
+        }
+        refresh_changed_rows();
+    });
+    // The subtree follows its top level when that is moved
+    connect(&account_directory, &AccountDirectory::subtree_moved, this, [this](const QString& old_path, const QString& new_path) {
+        auto& path = m_impl->path;
+        if(path == old_path) {
+            path = new_path;
+        } else if(path.startsWith(old_path + u':')) {
+            path = new_path + QStringView(path).mid(old_path.size());
+        } else {
+            return;
+        }
+        m_impl->account_ids.reset();
+        reload();
+    });
+}
+
+SubtreeTransactions::~SubtreeTransactions() noexcept
+{
+    delete m_impl;
+}
+
+int SubtreeTransactions::rowCount(const QModelIndex& parent) const
+{
+    if(parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(m_impl->keys.size());
+}
+
+int SubtreeTransactions::columnCount(const QModelIndex& parent) const
+{
+    if(parent.isValid()) {
+        return 0;
+    }
+    return Column_Count;
+}
+
+QVariant SubtreeTransactions::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid() || index.row() >= rowCount()) {
+        return {};
+    }
+    auto row = static_cast<size_t>(index.row());
+    if(role == Qt::TextAlignmentRole && index.column() >= Amount_Column) {
+        return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+    } else if(role != Qt::DisplayRole) {
+        return {};
+    }
+    switch(index.column()) {
+        case TRANSACTIONS_VIEW_ID:
+            return m_impl->keys[row].id;
+        case TRANSACTIONS_VIEW_DATE:
+            return QDate::fromJulianDay(m_impl->keys[row].date);
+        case TRANSACTIONS_VIEW_DESCRIPTION:
+            return m_impl->row_details(index.row()).description;
+        case TRANSACTIONS_VIEW_SOURCE:
+            return m_impl->account_directory->name(m_impl->row_details(index.row()).source);
+        case TRANSACTIONS_VIEW_DESTINATION:
+            return m_impl->account_directory->name(m_impl->row_details(index.row()).destination);
+        case Amount_Column:
+            return Money::from_units(m_impl->changes[row]).to_string();
+        case Balance_Column:
+            return Money::from_units(m_impl->balances[row]).to_string();
+        default:
+            return {};
+    }
+}
+
+QVariant SubtreeTransactions::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(role != Qt::DisplayRole) {
+        return {};
+    }
+    if(orientation == Qt::Vertical) {
+        return section + 1;
+    }
+    static const QStringList column_names = {
+        u"ID"_s, u"Date"_s, u"Description"_s, u"Source"_s, u"Destination"_s, u"Amount"_s, u"Balance"_s
+    };
+    return column_names.value(section);
+}
+
+bool SubtreeTransactions::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && !m_impl->fetched_all;
+}
+
+void SubtreeTransactions::fetchMore(const QModelIndex& parent)
+{
+    if(!canFetchMore(parent)) {
+        return;
+    }
+    std::vector<std::pair<RowKey, qint64>> fetched;
+    try {
+        fetched = m_impl->fetch_rows(page_size);
+    } catch(const sql_helpers::Error& err) {
+        m_impl->last_error = QString::fromStdString(err.what());
+        m_impl->fetched_all = true;
+        return;
+    }
+    if(fetched.empty()) {
+        return;
+    }
+    auto first_row = rowCount();
+    beginInsertRows({}, first_row, first_row + static_cast<int>(fetched.size()) - 1);
+    m_impl->append_rows(fetched);
+    endInsertRows();
+}
+
+const QString& SubtreeTransactions::path() const
+{
+    return m_impl->path;
+}
+
+QString SubtreeTransactions::last_error() const
+{
+    return m_impl->last_error;
+}
+
+qint64 SubtreeTransactions::balance() const
+{
+    return m_impl->balance;
+}
+
+void SubtreeTransactions::refresh_changed_rows()
+{
+    auto& impl = *m_impl;
+    // Changes that arrive in the meantime are applied once the refresh finishes
+    if(impl.changed_ids.empty() || impl.refreshing) {
+        return;
+    }
+    impl.refreshing = true;
+    std::vector<qint64> ids(impl.changed_ids.begin(), impl.changed_ids.end());
+    impl.changed_ids.clear();
+    impl.db_manager->run_async([path = impl.path, ids](QSqlDatabase& db) {
+        return read_changed_rows(db, path, ids);
+    }).then(this, [this, ids](const ChangedRows& result) {
+        m_impl->refreshing = false;
+        m_impl->apply_changes(*this, ids, result);
+        if(result.balance != m_impl->balance) {
+            m_impl->balance = result.balance;
+            emit balance_changed(m_impl->balance);
+        }
+        refresh_changed_rows();
+    }).onFailed(this, [this](const sql_helpers::Error& err) {
+        m_impl->refreshing = false;
+        m_impl->last_error = QString::fromStdString(err.what());
+    });
+}
+
+void SubtreeTransactions::reload()
+{
+    // As many rows as had been fetched are read again, so that the view keeps its place
+    auto row_limit = std::max(rowCount(), page_size);
+    beginResetModel();
+    m_impl->keys.clear();
+    m_impl->changes.clear();
+    m_impl->balances.clear();
+    m_impl->details.clear();
+    m_impl->resident_pages.clear();
+    // They are read again along with everything else
+    m_impl->changed_ids.clear();
+    m_impl->fetched_all = false;
+    try {
+        m_impl->append_rows(m_impl->fetch_rows(row_limit));
+        m_impl->balance = read_balance(m_impl->db, m_impl->path);
+    } catch(const sql_helpers::Error& err) {
+        m_impl->last_error = QString::fromStdString(err.what());
+        m_impl->fetched_all = true;
+    }
+    endResetModel();
+    emit balance_changed(m_impl->balance);
+}
@@ -0,0 +1,71 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QString>
+#include "models/SQLColumns.hpp"
+
+class AccountDirectory;
+class DatabaseManager;
+
+/* Every transaction involving an account under a level of the account hierarchy (e.g. all of
+   "Expenses"), in (date, id) order. Read-only. The amount column is the net change to the
+   subtree, so transfers between its own accounts count as 0, and the last column is the running
+   balance of the subtree. Rows are fetched a page at a time as the view scrolls, each page with
+   queries that stop once they have it, so a page costs the same however far down it is. The
+   path follows the subtree when it is moved. Only the descriptions and accounts of recently
+   shown pages are kept in memory.
+   Transactions changed by other views are read on the worker thread and moved into place */
+class SubtreeTransactions : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum Column {
+        Amount_Column = TRANSACTIONS_VIEW_COL_COUNT,
+        Balance_Column,
+
+        Column_Count
+    };
+
+    SubtreeTransactions(DatabaseManager&, const AccountDirectory&, const QString& path);
+    ~SubtreeTransactions() noexcept;
+
+    int rowCount(const QModelIndex& parent = {}) const override;
+    int columnCount(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex&, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    const QString& path() const;
+    QString last_error() const;
+    // Sum of the current balances of every account in the subtree, in cents
+    qint64 balance() const;
+signals:
+    void balance_changed(qint64 balance);
+private:
+    // Reads the transactions changed since the last refresh on the worker thread, then moves
+    // their rows into place
+    void refresh_changed_rows();
+    // Reads the fetched rows and the balance again (after accounts are renamed or deleted)
+    void reload();
+
+    struct Impl;
+    Impl* m_impl;
+};
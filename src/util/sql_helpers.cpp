@@ -17,11 +17,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "sql_helpers.hpp"
+#include <unordered_map>
 #include <QDir>
 #include <QFile>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QString>
+#include <QStringList>
 #include <QStringTokenizer>
 
 using namespace Qt::StringLiterals;
@@ -56,6 +58,58 @@ void next(QSqlQuery& query)
     try_(query, query.next());
 }
 
+// Prepared queries by connection name, then by query text
+static thread_local std::unordered_map<QString, std::unordered_map<QString, QSqlQuery>> statement_cache;
+
+QSqlQuery& prepared(const QSqlDatabase& db, const QString& query_text)
+{
+    auto& statements = statement_cache[db.connectionName()];
+    auto it = statements.find(query_text);
+    if(it == statements.end()) {
+        QSqlQuery query{db};
+        query.setForwardOnly(true);
+        prepare(query, query_text);
+        it = statements.emplace(query_text, std::move(query)).first;
+    } else {
+        // Resets the statement in case the last user didn't read all of its results
+        it->second.finish();
+    }
+    return it->second;
+}
+
+void clear_statement_cache(const QSqlDatabase& db)
+{
+    statement_cache.erase(db.connectionName());
+}
+
+Transaction::Transaction(const QSqlDatabase& db)
+    : m_db(db)
+{
+    QSqlQuery query{m_db};
+    exec(query, u"BEGIN IMMEDIATE"_s);
+}
+
+Transaction::~Transaction() noexcept
+{
+    if(!m_finished) {
+        QSqlQuery query{m_db};
+        query.exec(u"ROLLBACK"_s);
+    }
+}
+
+void Transaction::commit()
+{
+    QSqlQuery query{m_db};
+    exec(query, u"COMMIT"_s);
+    m_finished = true;
+}
+
+QString values_placeholders(size_t row_count, int column_count)
+{
+    auto row = u"(%1)"_s.arg(QStringList(column_count, u"?"_s).join(u", "));
+    return QStringList(static_cast<qsizetype>(row_count), row).join(u", ");
+}
+
 void upgrade_schema_if_needed(QSqlDatabase& db, int latest_schema_version, QString schema_dir_path)
 {
     QDir schema_folder{schema_dir_path};
@@ -70,10 +124,18 @@ void upgrade_schema_if_needed(QSqlDatabase& db, int latest_schema_version, QStri
     if(schema_version > latest_schema_version) {
         throw Error("Database has newer schema version than this software supports");
     } else if(schema_version < latest_schema_version) {
-        // Migrate to the latest schema
-        for(auto v = schema_version + 1; v <= latest_schema_version; ++v) {
-            try {
-                db.transaction();
+        // Foreign keys are not enforced during the migration so that a table that other tables
+        // refer to can be rebuilt (dropping it would otherwise delete the rows that refer to it).
+        // Each migration is checked for broken references before it is committed
+        exec(query, u"pragma foreign_keys"_s);
+        next(query);
+        auto foreign_keys = query.value(0).toBool();
+        query.finish();
+        exec(query, u"pragma foreign_keys = OFF"_s);
+        try {
+            // Migrate to the latest schema
+            for(auto v = schema_version + 1; v <= latest_schema_version; ++v) {
+                Transaction transaction{db};
                 auto schema_filename = u"%1-schema.sql"_s.arg(v);
                 auto schema_path = schema_folder.filePath(schema_filename);
                 QFile schema_file{schema_path};
@@ -87,12 +149,21 @@ void upgrade_schema_if_needed(QSqlDatabase& db, int latest_schema_version, QStri
                         exec(query, statement.toString());
                     }
                 }
-                exec(query, u"pragma user_version = %1"_s.arg(latest_schema_version));
-                db.commit();
-            } catch(const std::exception&) {
-                db.rollback();
-                throw;
+                exec(query, u"pragma foreign_key_check"_s);
+                if(query.next()) {
+                    throw Error(u"Schema migration failed - '%1' broke a foreign key"_s.arg(schema_filename).toStdString());
+                }
+                exec(query, u"pragma user_version = %1"_s.arg(v));
+                transaction.commit();
+            }
+        } catch(const Error&) {
+            if(foreign_keys) {
+                query.exec(u"pragma foreign_keys = ON"_s);
             }
+            throw;
+        }
+        if(foreign_keys) {
+            exec(query, u"pragma foreign_keys = ON"_s);
         }
     }
 }
@@ -18,14 +18,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <optional>
 #include <stdexcept>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
 
-QT_BEGIN_NAMESPACE
-class QSqlDatabase;
-QT_END_NAMESPACE
-
 namespace sql_helpers {
 
 struct Error : public std::runtime_error {
@@ -37,6 +37,76 @@ void exec(QSqlQuery&, const QString& query_text);
 void exec(QSqlQuery&);
 void next(QSqlQuery&);
 
+/* Returns a forward-only query for query_text that has already been prepared on the given
+   connection, preparing it only the first time a given text is used. Cached queries belong to
+   the calling thread, so they must only be used on the thread that owns the connection. Since a
+   cached query is never destroyed, call finish() on it once done reading its results (otherwise
+   its statement stays open). The reference stays valid until clear_statement_cache() */
+QSqlQuery& prepared(const QSqlDatabase&, const QString& query_text);
+// Must be called (on the thread that owns the connection) before the connection is closed
+void clear_statement_cache(const QSqlDatabase&);
+
+/* A write transaction that is rolled back when destroyed unless commit() was called. It is
+   started with BEGIN IMMEDIATE so that if another connection is writing, it waits (up to the busy
+   timeout) before starting instead of failing part way through */
+class Transaction {
+public:
+    explicit
+    Transaction(const QSqlDatabase&);
+    ~Transaction() noexcept;
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    void commit();
+private:
+    QSqlDatabase m_db;
+    bool m_finished = false;
+};
+
+// Most values that exec_batched() binds to one statement (SQLite's limit before version 3.32)
+constexpr int max_bound_values = 999;
+
+// Placeholders for a multi-row VALUES clause, e.g. "(?, ?), (?, ?)"
+QString values_placeholders(size_t row_count, int column_count);
+
+/* Runs a statement once per batch of rows, where make_text(n) returns the statement text for a
+   batch of n rows and bind_row(query, i) binds the values of row i. Batches are as large as
+   possible without binding more than max_bound_values. The statement for a full batch is cached.
+   read_results(query), if given, is called after each batch runs */
+template<typename MakeText, typename BindRow, typename ReadResults>
+void exec_batched(const QSqlDatabase& db, size_t row_count, int values_per_row, MakeText make_text, BindRow bind_row,
+                  ReadResults read_results)
+{
+    auto batch_size = static_cast<size_t>(std::max(max_bound_values / values_per_row, 1));
+    for(size_t start = 0; start < row_count; start += batch_size) {
+        auto count = std::min(batch_size, row_count - start);
+        // Partial batches (at most one per call) have a different length each time, so
+        // they aren't worth caching
+        std::optional<QSqlQuery> partial_query;
+        QSqlQuery* query;
+        if(count == batch_size) {
+            query = &prepared(db, make_text(count));
+        } else {
+            partial_query.emplace(db);
+            partial_query->setForwardOnly(true);
+            prepare(*partial_query, make_text(count));
+            query = &*partial_query;
+        }
+        for(size_t i = start; i < start + count; ++i) {
+            bind_row(*query, i);
+        }
+        exec(*query);
+        read_results(*query);
+        query->finish();
+    }
+}
+
+template<typename MakeText, typename BindRow>
+void exec_batched(const QSqlDatabase& db, size_t row_count, int values_per_row, MakeText make_text, BindRow bind_row)
+{
+    exec_batched(db, row_count, values_per_row, make_text, bind_row, [](QSqlQuery&) {});
+}
+
 void upgrade_schema_if_needed(QSqlDatabase&, int latest_schema_version, QString schema_dir_path);
 
 } // namespace sql_helpers
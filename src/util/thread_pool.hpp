@@ -0,0 +1,65 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <QFuture>
+#include <QPromise>
+#include <QThreadPool>
+
+namespace thread_pool {
+
+// Runs task() on the global thread pool. Any exception thrown by the task is stored in the
+// returned future
+template<typename Task>
+auto run(Task task) -> QFuture<std::invoke_result_t<Task&>>
+{
+    using Result = std::invoke_result_t<Task&>;
+    auto promise = std::make_shared<QPromise<Result>>();
+    auto future = promise->future();
+    promise->start();
+    QThreadPool::globalInstance()->start([promise, task = std::move(task)]() mutable {
+        try {
+            if constexpr(std::is_void_v<Result>) {
+                task();
+            } else {
+                promise->addResult(task());
+            }
+        } catch(...) {
+            promise->setException(std::current_exception());
+        }
+        promise->finish();
+    });
+    return future;
+}
+
+// How many tasks to keep queued ahead of the one whose result is being used, so that the pool
+// stays busy without results piling up
+inline
+size_t max_tasks_ahead()
+{
+    return static_cast<size_t>(std::max(QThreadPool::globalInstance()->maxThreadCount(), 1)) * 2;
+}
+
+} // namespace thread_pool
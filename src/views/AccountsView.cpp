@@ -18,6 +18,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "AccountsView.hpp"
 #include <QErrorMessage>
+#include <QHeaderView>
+#include <QInputDialog>
+#include <QPersistentModelIndex>
 #include "models/AccountTree.hpp"
 #include "models/DatabaseManager.hpp"
 #include "models/Roles.hpp"
@@ -30,10 +33,10 @@ using namespace Qt::StringLiterals;
 struct AccountsView::Impl {
     void update_button_statuses(const QModelIndex& selected_index)
     {
-        auto* item = account_tree->itemFromIndex(selected_index);
-        bool is_placeholder = item->data(Account_Kind_Role).toInt() == ACCOUNT_KIND_PLACEHOLDER;
+        bool is_placeholder = selected_index.data(Account_Kind_Role).toInt() == ACCOUNT_KIND_PLACEHOLDER;
         ui.add_account->setEnabled(is_placeholder);
-        ui.delete_account->setEnabled(!item->hasChildren() && selected_index.parent() != QModelIndex{});
+        ui.delete_account->setEnabled(!account_tree->hasChildren(selected_index) && selected_index.parent() != QModelIndex{});
+        ui.move_account->setEnabled(selected_index.parent() != QModelIndex{});
     }
 
     AccountTree* account_tree;
@@ -46,9 +49,13 @@ AccountsView::AccountsView(AccountTree& account_tree, DatabaseManager& db_manage
 {
     m_impl->ui.setupUi(this);
     m_impl->ui.tree_view->setModel(&account_tree);
+    auto* header = m_impl->ui.tree_view->header();
+    header->setStretchLastSection(false);
+    header->setSectionResizeMode(AccountTree::Name_Column, QHeaderView::Stretch);
+    header->setSectionResizeMode(AccountTree::Balance_Column, QHeaderView::ResizeToContents);
 
     connect(m_impl->ui.add_account, &QToolButton::clicked, [this] {
-        auto selected_items = m_impl->ui.tree_view->selectionModel()->selectedIndexes();
+        auto selected_items = m_impl->ui.tree_view->selectionModel()->selectedRows();
         if(selected_items.size() != 1) {
             // Can only add under single parent at a time
             return;
@@ -64,43 +71,63 @@ AccountsView::AccountsView(AccountTree& account_tree, DatabaseManager& db_manage
     });
 
     connect(m_impl->ui.delete_account, &QToolButton::clicked, [this] {
-        auto selected_items = m_impl->ui.tree_view->selectionModel()->selectedIndexes();
+        auto selected_items = m_impl->ui.tree_view->selectionModel()->selectedRows();
         if(selected_items.size() != 1) {
             // Can only add under single parent at a time
             return;
         }
         auto index = selected_items[0];
-        auto* item = m_impl->account_tree->itemFromIndex(index);
-        if(item->hasChildren()) {
+        if(m_impl->account_tree->hasChildren(index)) {
+            return;
+        }
+        // The row is removed once the account has been deleted (errors are reported by the tree)
+        m_impl->account_tree->removeRow(index.row(), index.parent());
+    });
+    // Needed because QItemSelectionModel::selectionChanged occurs before a removal fully
+    // completes, so the child item hasn't been deleted from its parent yet
+    connect(m_impl->account_tree, &QAbstractItemModel::rowsRemoved, this, [this] {
+        auto selected_items = m_impl->ui.tree_view->selectionModel()->selectedRows();
+        if(!selected_items.empty()) {
+            m_impl->update_button_statuses(selected_items[0]);
+        }
+    });
+
+    connect(m_impl->ui.move_account, &QToolButton::clicked, [this] {
+        auto selected_items = m_impl->ui.tree_view->selectionModel()->selectedRows();
+        if(selected_items.size() != 1) {
+            return;
+        }
+        QPersistentModelIndex index{selected_items[0]};
+        bool ok = false;
+        auto new_path = QInputDialog::getText(this, u"Move Account"_s, u"New path (everything under the account moves with it):"_s,
+                                              QLineEdit::Normal, index.data(Account_Path_Role).toString(), &ok);
+        if(!ok || !index.isValid()) {
             return;
         }
         try {
-            m_impl->account_tree->removeRow(index.row(), index.parent());
-            // Needed because QItemSelectionModel::selectionChanged occurs before removeRow fully
-            // completes, so the child item hasn't been deleted from its parent yet
-            auto new_selected_item = m_impl->ui.tree_view->selectionModel()->selectedIndexes()[0];
-            m_impl->update_button_statuses(new_selected_item);
-        } catch(const sql_helpers::Error&) {
+            m_impl->account_tree->move_account(index, new_path.trimmed());
+        } catch(const sql_helpers::Error& err) {
             auto* error_modal = new QErrorMessage(this);
             error_modal->setModal(true);
             error_modal->setAttribute(Qt::WA_DeleteOnClose);
-            error_modal->showMessage(u"Failed to delete account (check that no transactions reference this account)"_s);
+            error_modal->showMessage(u"Failed to move account\n(Reason: %1)"_s.arg(err.what()));
         }
     });
 
     connect(m_impl->ui.tree_view->selectionModel(), &QItemSelectionModel::selectionChanged, [this] {
         if(m_impl->ui.tree_view->selectionModel()->hasSelection()) {
             // Tree view is guaranteed to have exactly 1 item selected
-            auto index = m_impl->ui.tree_view->selectionModel()->selectedIndexes()[0];
+            auto index = m_impl->ui.tree_view->selectionModel()->selectedRows()[0];
             m_impl->update_button_statuses(index);
         } else {
             m_impl->ui.add_account->setEnabled(false);
             m_impl->ui.delete_account->setEnabled(false);
+            m_impl->ui.move_account->setEnabled(false);
         }
     });
 
     connect(m_impl->ui.tree_view, &QAbstractItemView::activated, [this](const QModelIndex& index) {
-        if(index.data(Account_Kind_Role) != ACCOUNT_KIND_PLACEHOLDER) {
+        if(index.data(Account_Kind_Role) != ACCOUNT_KIND_PLACEHOLDER || m_impl->account_tree->hasChildren(index)) {
             emit activated(index);
         }
     });
@@ -19,13 +19,17 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "MainWindow.hpp"
 #include <QErrorMessage>
 #include <QFileDialog>
+#include <QStatusBar>
 #include <QTabBar>
+#include "import/Categoriser.hpp"
 #include "models/AccountTree.hpp"
 #include "models/DatabaseManager.hpp"
 #include "models/Roles.hpp"
+#include "util/sql_helpers.hpp"
 #include "views/AccountsView.hpp"
 #include "views/AboutDialog.hpp"
 #include "views/SecurityEditor.hpp"
+#include "views/SubtreeView.hpp"
 #include "TransactionsView.hpp"
 #include "ui_mainwindow.h"
 
@@ -55,10 +59,25 @@ MainWindow::MainWindow(AccountTree& account_tree, DatabaseManager& db_manager)
 
     connect(this, &MainWindow::database_path_changed, &db_manager, &DatabaseManager::load_database);
     connect(&db_manager, &DatabaseManager::database_closing, this, &MainWindow::reset);
-    connect(&db_manager, &DatabaseManager::failed_to_load_database, [this](const QString& message) {
+    auto show_error = [this](const QString& message) {
         auto* error_dialog = new QErrorMessage(this);
         error_dialog->setAttribute(Qt::WA_DeleteOnClose);
         error_dialog->showMessage(message);
+    };
+    connect(&db_manager, &DatabaseManager::failed_to_load_database, show_error);
+    connect(&account_tree, &AccountTree::error_occurred, show_error);
+    // Tabs are named by account path, so they are renamed along with their accounts
+    connect(&account_tree.account_directory(), &AccountDirectory::subtree_moved, this,
+            [this](const QString& old_path, const QString& new_path) {
+        auto* tabs = m_impl->ui.tabs;
+        for(int i = 1; i < tabs->count(); ++i) {
+            auto tab_name = tabs->tabText(i);
+            if(tab_name == old_path || tab_name.startsWith(old_path + u':')) {
+                tab_name = new_path + QStringView(tab_name).mid(old_path.size());
+                tabs->setTabText(i, tab_name);
+                tabs->setTabToolTip(i, tab_name);
+            }
+        }
     });
 
     // Menus
@@ -78,6 +97,15 @@ MainWindow::MainWindow(AccountTree& account_tree, DatabaseManager& db_manager)
         auto* security_editor = new SecurityEditor(db_manager.database(), this);
         security_editor->show();
     });
+    connect(m_impl->ui.recategorise_transactions, &QAction::triggered, [this, &db_manager, show_error] {
+        db_manager.run_async([](QSqlDatabase& db) {
+            return recategorise_transactions(db);
+        }).then(this, [this](qint64 count) {
+            statusBar()->showMessage(u"Recategorised %1 transactions"_s.arg(count), 5000);
+        }).onFailed(this, [show_error](const sql_helpers::Error& err) {
+            show_error(u"Failed to apply categorisation rules\n(Reason: %1)"_s.arg(err.what()));
+        });
+    });
     connect(m_impl->ui.show_licenses, &QAction::triggered, [this] {
         auto* about_box = new AboutDialog(this);
         about_box->show();
@@ -119,11 +147,15 @@ void MainWindow::open_transactions_view(const QModelIndex& account)
             return;
         }
     }
-    auto account_transactions = m_impl->account_tree->account_transactions(account);
-    if(!account_transactions) {
+    QWidget* transactions_view = nullptr;
+    if(m_impl->account_tree->hasChildren(account)) {
+        // Parent accounts show everything below them
+        transactions_view = new SubtreeView(m_impl->account_tree->subtree_transactions(account), m_impl->account_tree->account_directory());
+    } else if(auto account_transactions = m_impl->account_tree->account_transactions(account)) {
+        transactions_view = new TransactionsView(std::move(account_transactions), m_impl->account_tree->account_directory());
+    } else {
         return;
     }
-    auto* transactions_view = new TransactionsView(std::move(account_transactions));
     auto tab_index = m_impl->ui.tabs->addTab(transactions_view, tab_name);
     m_impl->ui.tabs->setTabToolTip(tab_index, tab_name);
     m_impl->ui.tabs->setCurrentIndex(tab_index);
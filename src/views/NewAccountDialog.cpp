@@ -49,6 +49,7 @@ struct NewAccountDialog::Impl {
 
         placeholders.setSourceModel(&account_tree);
         ui.parent_accounts_view->setModel(&placeholders);
+        ui.parent_accounts_view->hideColumn(AccountTree::Balance_Column);
         ui.parent_accounts_view->setCurrentIndex(placeholders.mapFromSource(initial_parent_index));
 
         account_kinds.setQuery(u"SELECT id, name FROM account_kinds ORDER BY name"_s, db_manager.database());
@@ -110,7 +111,7 @@ void NewAccountDialog::accept()
     auto account_kind = m_impl->account_kinds.index(account_kind_index, 0).data().toInt();
 
     auto parent_account = m_impl->placeholders.mapToSource(
-        m_impl->ui.parent_accounts_view->selectionModel()->selectedIndexes()[0]
+        m_impl->ui.parent_accounts_view->selectionModel()->selectedRows()[0]
     );
 
     QString symbol;
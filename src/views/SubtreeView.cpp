@@ -0,0 +1,63 @@
+/*
+QAccountant - personal accounting software
+Copyright (C) 2025  Cole Blakley
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SubtreeView.hpp"
+#include "models/AccountDirectory.hpp"
+#include "models/Money.hpp"
+#include "ui_SubtreeView.h"
+
+using namespace Qt::StringLiterals;
+
+struct SubtreeView::Impl {
+    Impl(SubtreeView* owner, std::unique_ptr<SubtreeTransactions> transactions, AccountDirectory& account_directory)
+        : m_transactions(std::move(transactions))
+    {
+        m_ui.setupUi(owner);
+        m_ui.transactions_view->setModel(m_transactions.get());
+        m_ui.transactions_view->hideColumn(TRANSACTIONS_VIEW_ID);
+        show_balance(m_transactions->balance());
+        connect(m_transactions.get(), &SubtreeTransactions::balance_changed, owner, [this](qint64 balance) {
+            show_balance(balance);
+        });
+        // Redraw account names when accounts are added, removed, or renamed
+        auto* viewport = m_ui.transactions_view->viewport();
+        connect(&account_directory, &AccountDirectory::rowsInserted, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::rowsRemoved, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::rowsMoved, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::dataChanged, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::modelReset, viewport, qOverload<>(&QWidget::update));
+        m_ui.transactions_view->resizeColumnsToContents();
+    }
+
+    void show_balance(qint64 balance)
+    {
+        m_ui.balance->setText(u"Balance: %1"_s.arg(Money::from_units(balance).to_string()));
+    }
+
+    std::unique_ptr<SubtreeTransactions> m_transactions;
+    Ui::SubtreeView m_ui;
+};
+
+SubtreeView::SubtreeView(std::unique_ptr<SubtreeTransactions> transactions, AccountDirectory& account_directory)
+    : QFrame(), m_impl(new Impl(this, std::move(transactions), account_directory))
+{}
+
+SubtreeView::~SubtreeView() noexcept
+{
+    delete m_impl;
+}
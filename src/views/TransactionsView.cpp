@@ -18,34 +18,29 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "TransactionsView.hpp"
 #include <algorithm>
+#include <functional>
 #include <vector>
+#include <QCheckBox>
 #include <QComboBox>
+#include <QDate>
+#include <QDateEdit>
 #include <QErrorMessage>
 #include <QStyledItemDelegate>
 #include <QDoubleSpinBox>
-#include <QSqlQueryModel>
-#include <QSqlError>
+#include "models/AccountDirectory.hpp"
+#include "models/Roles.hpp"
 #include "models/SQLColumns.hpp"
 #include "ui_transactionsview.h"
 
 using namespace Qt::StringLiterals;
 
-static const QString relation_query_text = u"SELECT id, name FROM accounts ORDER BY name"_s;
-
 /* Maps account IDs into account names for display. Also provides a combo box editor for
    selecting an account name */
 struct AccountRelationDelegate : public QStyledItemDelegate {
-    enum {
-        ID_COLUMN,
-        NAME_COLUMN
-    };
-
     explicit
-    AccountRelationDelegate(const QSqlDatabase& db, QWidget* parent = nullptr)
-        : QStyledItemDelegate(parent)
-    {
-        m_account_names.setQuery(relation_query_text, db);
-    }
+    AccountRelationDelegate(AccountDirectory& account_directory, QWidget* parent = nullptr)
+        : QStyledItemDelegate(parent), m_account_directory(&account_directory)
+    {}
 
     QWidget* createEditor(QWidget* parent, const QStyleOptionViewItem&, const QModelIndex&) const override;
     void setEditorData(QWidget* editor, const QModelIndex&) const override;
@@ -53,9 +48,7 @@ struct AccountRelationDelegate : public QStyledItemDelegate {
     QString displayText(const QVariant&, const QLocale&) const override;
     void setModelData(QWidget* editor, QAbstractItemModel*, const QModelIndex&) const override;
 private:
-    QModelIndex find_account_name_index(int account_id) const;
-
-    QSqlQueryModel m_account_names;
+    AccountDirectory* m_account_directory;
 };
 
 struct DefaultDelegate : public QStyledItemDelegate {
@@ -63,20 +56,19 @@ struct DefaultDelegate : public QStyledItemDelegate {
 
     QWidget* createEditor(QWidget* parent, const QStyleOptionViewItem& option, const QModelIndex& index) const override
     {
-        /* Disallows edits on cells containing null data (except if the row is new and hasn't been submitted yet) */
-        if(index.data().isNull() && !index.siblingAtColumn(TRANSACTIONS_VIEW_ID).data().isNull()) {
-            return nullptr;
-        }
         auto* editor = QStyledItemDelegate::createEditor(parent, option, index);
         if(auto* spinbox = qobject_cast<QDoubleSpinBox*>(editor)) {
-            spinbox->setDecimals(4);
+            // Amounts are stored as fixed-point integers, so only allow as many decimal
+            // places as the column can hold
+            auto decimals = index.data(Decimal_Places_Role);
+            spinbox->setDecimals(decimals.isValid() ? decimals.toInt() : 4);
         }
         return editor;
     }
 };
 
 struct TransactionsView::Impl {
-    Impl(TransactionsView* owner, std::unique_ptr<QSqlTableModel> transactions)
+    Impl(TransactionsView* owner, std::unique_ptr<AccountTransactions> transactions, AccountDirectory& account_directory)
         : m_transactions(std::move(transactions)), m_error_modal(new QErrorMessage(owner))
     {
         m_ui.setupUi(owner);
@@ -98,48 +90,94 @@ struct TransactionsView::Impl {
         });
 
         connect(m_ui.delete_transaction, &QToolButton::clicked, [this] {
-            auto selected_items = m_ui.transactions_view->selectionModel()->selectedIndexes();
+            std::vector<int> selected_rows;
+            for(const auto& item : m_ui.transactions_view->selectionModel()->selectedIndexes()) {
+                selected_rows.push_back(item.row());
+            }
             // Remove starting from highest index to avoid invalidating indices when deleting
-            std::ranges::sort(selected_items, [](const auto& a, const auto& b) { return a.row() > b.row(); });
-            for(auto item : selected_items) {
-                m_ui.transactions_view->hideRow(item.row());
-                m_transactions->removeRow(item.row());
-                m_hidden_rows.push_back(item.row());
+            std::ranges::sort(selected_rows, std::greater{});
+            auto duplicates = std::ranges::unique(selected_rows);
+            selected_rows.erase(duplicates.begin(), duplicates.end());
+            for(auto row : selected_rows) {
+                m_transactions->removeRow(row);
             }
             set_dirty();
         });
 
+        // Rows marked to be deleted are hidden. Rows can be inserted and moved while deletions are
+        // pending, so which rows are hidden is always read back from the model
+        connect(m_transactions.get(), &QAbstractItemModel::dataChanged,
+                [this](const QModelIndex& top_left, const QModelIndex& bottom_right, const QList<int>& roles) {
+            if(roles.empty() || roles.contains(Pending_Delete_Role)) {
+                sync_hidden_rows(top_left.row(), bottom_right.row());
+            }
+        });
+        connect(m_transactions.get(), &QAbstractItemModel::rowsInserted, [this](const QModelIndex&, int first, int last) {
+            sync_hidden_rows(first, last);
+        });
+        auto sync_all_hidden_rows = [this] { sync_hidden_rows(0, m_transactions->rowCount() - 1); };
+        connect(m_transactions.get(), &QAbstractItemModel::rowsMoved, sync_all_hidden_rows);
+        connect(m_transactions.get(), &QAbstractItemModel::rowsRemoved, sync_all_hidden_rows);
+        connect(m_transactions.get(), &QAbstractItemModel::modelReset, sync_all_hidden_rows);
+
         connect(m_ui.submit_changes, &QToolButton::clicked, [this] {
-            if(m_transactions->submitAll()) {
-                clear_pending_changes();
-                // Note: Submitting the changes causes the view to be refreshed, after
-                //  which no row will be selected. This means the delete_transaction
-                //  button should be greyed out
-                m_ui.delete_transaction->setEnabled(false);
-            } else {
-                auto error_msg = m_transactions->lastError().text();
-                if(error_msg.isEmpty()) {
-                    error_msg = u"Failed to submit changes (check that new rows have all fields filled out)"_s;
-                }
-                m_error_modal->showMessage(error_msg);
+            // The buttons stay disabled until the worker thread has finished writing the changes
+            set_dirty(false);
+            m_ui.new_transaction->setEnabled(false);
+            m_ui.delete_transaction->setEnabled(false);
+            set_date_filter_enabled(false);
+            m_transactions->submit_all();
+        });
+        connect(m_transactions.get(), &AccountTransactions::submitted, [this] {
+            m_ui.new_transaction->setEnabled(true);
+            clear_pending_changes();
+            // Submitted rows are updated in place, so the selection (minus any deleted rows) is kept
+            m_ui.delete_transaction->setEnabled(m_ui.transactions_view->selectionModel()->hasSelection());
+        });
+        connect(m_transactions.get(), &AccountTransactions::submit_failed, [this](QString error_msg) {
+            m_ui.new_transaction->setEnabled(true);
+            m_ui.delete_transaction->setEnabled(m_ui.transactions_view->selectionModel()->hasSelection());
+            set_dirty();
+            if(error_msg.isEmpty()) {
+                error_msg = u"Failed to submit changes (check that new rows have all fields filled out)"_s;
             }
+            m_error_modal->showMessage(error_msg);
         });
 
         connect(m_ui.revert_changes, &QToolButton::clicked, [this] {
-            m_transactions->revertAll();
+            m_transactions->revert_all();
             clear_pending_changes();
         });
 
+        // Once turned on, the last 90 days are shown unless other dates are picked
+        auto today = QDate::currentDate();
+        m_ui.first_date->setDate(today.addDays(-90));
+        m_ui.last_date->setDate(today);
+        connect(m_ui.date_filter, &QCheckBox::toggled, [this](bool checked) {
+            m_ui.first_date->setEnabled(checked);
+            m_ui.last_date->setEnabled(checked);
+            apply_date_range();
+        });
+        connect(m_ui.first_date, &QDateEdit::dateChanged, [this] { apply_date_range(); });
+        connect(m_ui.last_date, &QDateEdit::dateChanged, [this] { apply_date_range(); });
+
         auto* default_delegate = new DefaultDelegate(owner);
         m_ui.transactions_view->setItemDelegate(default_delegate);
-        auto* account_relation_delegate = new AccountRelationDelegate(m_transactions->database(), owner);
+        auto* account_relation_delegate = new AccountRelationDelegate(account_directory, owner);
         m_ui.transactions_view->setItemDelegateForColumn(TRANSACTIONS_VIEW_SOURCE, account_relation_delegate);
         m_ui.transactions_view->setItemDelegateForColumn(TRANSACTIONS_VIEW_DESTINATION, account_relation_delegate);
-
-        // Resize columns whenever a cell is edited (since this could change the width of its column)
+        // Redraw account names when accounts are added, removed, or renamed
+        auto* viewport = m_ui.transactions_view->viewport();
+        connect(&account_directory, &AccountDirectory::rowsInserted, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::rowsRemoved, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::rowsMoved, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::dataChanged, viewport, qOverload<>(&QWidget::update));
+        connect(&account_directory, &AccountDirectory::modelReset, viewport, qOverload<>(&QWidget::update));
+
+        // Resize the edited cell's column (since the edit could change its width)
         auto on_commit = [this] {
-            m_ui.transactions_view->resizeColumnsToContents();
-            set_dirty(m_transactions->isDirty());
+            m_ui.transactions_view->resizeColumnToContents(m_ui.transactions_view->currentIndex().column());
+            set_dirty(m_transactions->is_dirty());
         };
         connect(m_ui.transactions_view->itemDelegate(), &QAbstractItemDelegate::commitData, on_commit);
         connect(account_relation_delegate, &AccountRelationDelegate::commitData, on_commit);
@@ -150,26 +188,47 @@ struct TransactionsView::Impl {
     {
         m_ui.submit_changes->setEnabled(value);
         m_ui.revert_changes->setEnabled(value);
+        // Changing the dates refetches the rows, so it waits until the changes are submitted or reverted
+        set_date_filter_enabled(!value);
+    }
+
+    void set_date_filter_enabled(bool value)
+    {
+        m_ui.date_filter->setEnabled(value);
+        m_ui.first_date->setEnabled(value && m_ui.date_filter->isChecked());
+        m_ui.last_date->setEnabled(value && m_ui.date_filter->isChecked());
+    }
+
+    void apply_date_range()
+    {
+        auto filtered = m_ui.date_filter->isChecked();
+        if(!m_transactions->set_date_range(filtered ? m_ui.first_date->date() : QDate(),
+                                           filtered ? m_ui.last_date->date() : QDate())) {
+            m_error_modal->showMessage(u"Submit or revert the pending changes before changing the dates shown"_s);
+        }
     }
 
     void clear_pending_changes()
     {
         set_dirty(false);
-        for(auto row : m_hidden_rows) {
-            m_ui.transactions_view->setRowHidden(row, false);
+        sync_hidden_rows(0, m_transactions->rowCount() - 1);
+    }
+
+    void sync_hidden_rows(int first, int last)
+    {
+        for(int row = first; row <= last; ++row) {
+            auto is_deleted = m_transactions->index(row, 0).data(Pending_Delete_Role).toBool();
+            m_ui.transactions_view->setRowHidden(row, is_deleted);
         }
-        m_hidden_rows.clear();
-        m_ui.transactions_view->resizeColumnsToContents();
     }
 
-    std::unique_ptr<QSqlTableModel> m_transactions;
+    std::unique_ptr<AccountTransactions> m_transactions;
     QErrorMessage* m_error_modal;
     Ui::TransactionsView m_ui;
-    std::vector<int> m_hidden_rows;
 };
 
-TransactionsView::TransactionsView(std::unique_ptr<QSqlTableModel> transactions)
-    : QFrame(), m_impl(new Impl(this, std::move(transactions)))
+TransactionsView::TransactionsView(std::unique_ptr<AccountTransactions> transactions, AccountDirectory& account_directory)
+    : QFrame(), m_impl(new Impl(this, std::move(transactions), account_directory))
 {}
 
 TransactionsView::~TransactionsView() noexcept
@@ -177,24 +236,17 @@ TransactionsView::~TransactionsView() noexcept
     delete m_impl;
 }
 
-QWidget* AccountRelationDelegate::createEditor(QWidget* parent, const QStyleOptionViewItem&, const QModelIndex& index) const
+QWidget* AccountRelationDelegate::createEditor(QWidget* parent, const QStyleOptionViewItem&, const QModelIndex&) const
 {
-    auto& self = const_cast<AccountRelationDelegate&>(*this);
-    const auto* transactions_model = static_cast<const QSqlTableModel*>(index.model());
-    self.m_account_names.setQuery(relation_query_text, transactions_model->database());
-
     auto* combo_box = new QComboBox(parent);
-    combo_box->setModel(&self.m_account_names);
-    combo_box->setModelColumn(NAME_COLUMN); // Only show the account name, not the ID
+    combo_box->setModel(m_account_directory);
     return combo_box;
 }
 
 void AccountRelationDelegate::setEditorData(QWidget* editor, const QModelIndex& index) const
 {
-    auto account_id = index.data().toInt();
-    auto account_name_index = find_account_name_index(account_id);
     auto* combo_box = static_cast<QComboBox*>(editor);
-    combo_box->setCurrentIndex(account_name_index.row());
+    combo_box->setCurrentIndex(m_account_directory->row(index.data().toInt()));
 }
 
 void AccountRelationDelegate::updateEditorGeometry(QWidget* editor, const QStyleOptionViewItem& option, const QModelIndex&) const
@@ -204,28 +256,11 @@ void AccountRelationDelegate::updateEditorGeometry(QWidget* editor, const QStyle
 
 QString AccountRelationDelegate::displayText(const QVariant& value, const QLocale&) const
 {
-    auto account_id = value.toInt();
-    auto account_name_index = find_account_name_index(account_id);
-    return account_name_index.siblingAtColumn(NAME_COLUMN).data().toString();
+    return m_account_directory->name(value.toInt());
 }
 
 void AccountRelationDelegate::setModelData(QWidget* editor, QAbstractItemModel* model, const QModelIndex& index) const
 {
     auto* combo_box = static_cast<QComboBox*>(editor);
-    int row = combo_box->currentIndex();
-    auto account_id = combo_box->model()->index(row, ID_COLUMN).data().toInt();
-    model->setData(index, account_id);
-}
-
-// TODO: this is a linear scan of the query results - might be too slow for large numbers of accounts
-QModelIndex AccountRelationDelegate::find_account_name_index(int account_id) const
-{
-    int row_count = m_account_names.rowCount();
-    for(int row = 0; row < row_count; ++row) {
-        auto i = m_account_names.index(row, ID_COLUMN);
-        if(i.data().toInt() == account_id) {
-            return i;
-        }
-    }
-    return {};
+    model->setData(index, combo_box->currentData(Account_ID_Role).toInt());
 }
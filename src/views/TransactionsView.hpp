@@ -20,13 +20,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <memory>
 #include <QFrame>
-#include <QSqlTableModel>
+#include "models/AccountTransactions.hpp"
+
+class AccountDirectory;
 
 class TransactionsView : public QFrame {
     Q_OBJECT
 public:
     explicit
-    TransactionsView(std::unique_ptr<QSqlTableModel>);
+    TransactionsView(std::unique_ptr<AccountTransactions>, AccountDirectory&);
     ~TransactionsView() noexcept;
 private:
     struct Impl;
@@ -1,9 +1,17 @@
 #include <iterator>
+#include <vector>
+#include <QDate>
+#include <QSemaphore>
+#include <QSignalSpy>
+#include <QSqlError>
+#include <QSqlQuery>
 #include <QTest>
 #include "DatabaseManager.hpp"
 #include "SQLColumns.hpp"
 #include "Roles.hpp"
 #include "AccountTree.hpp"
+#include "import/LedgerWriter.hpp"
+#include "util/sql_helpers.hpp"
 
 using namespace Qt::StringLiterals;
 
@@ -43,8 +51,9 @@ private slots:
             {u"Liabilities"_s, 5},
         };
 
-        QCOMPARE(tree.rowCount(), std::size(expected_rows));
-        QCOMPARE(tree.columnCount(), 1);
+        // The database is loaded on a background thread
+        QTRY_COMPARE(tree.rowCount(), std::size(expected_rows));
+        QCOMPARE(tree.columnCount(), 2);
 
         for(int row = 0; row < tree.rowCount(); ++row) {
             auto index = tree.index(row, 0);
@@ -59,15 +68,552 @@ private slots:
     {
         AccountTree tree{db_manager};
         db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
 
         auto assets = tree.index(0, 0);
         tree.appendRow(AccountFields{AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}}, assets);
         auto child_index = tree.index(0, 0, assets);
         QCOMPARE(child_index.data(), u"Checking"_s);
-        QCOMPARE(child_index.data(Account_ID_Role), 6);
+        // The ID is filled in once the account has been inserted
+        QTRY_COMPARE(child_index.data(Account_ID_Role), 6);
         QCOMPARE(child_index.data(Account_Path_Role), u"Assets:Checking"_s);
         QCOMPARE(child_index.data(Account_Kind_Role), ACCOUNT_KIND_BANK);
     }
+
+    void remove_child_account()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto assets = tree.index(0, 0);
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, assets);
+        auto savings = tree.appendRow(AccountFields{u"Savings"_s, u""_s, ACCOUNT_KIND_BANK}, assets);
+        QTRY_VERIFY(!checking.data(Account_ID_Role).isNull() && !savings.data(Account_ID_Role).isNull());
+
+        // The row goes once the account has been deleted on the worker thread
+        QVERIFY(tree.removeRow(checking.row(), assets));
+        QTRY_COMPARE(tree.rowCount(assets), 1);
+        auto remaining = tree.index(0, 0, assets);
+        QCOMPARE(remaining.data(Account_Path_Role), u"Assets:Savings"_s);
+        QCOMPARE(remaining.parent(), assets);
+        QVERIFY(!tree.index(1, 0, assets).isValid());
+
+        // Accounts that transactions reference can't be deleted, so they stay
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'Deposit', 4, 7, 100)"_s));
+        QSignalSpy error_spy{&tree, &AccountTree::error_occurred};
+        QVERIFY(tree.removeRow(0, assets));
+        QTRY_COMPARE(error_spy.count(), 1);
+        QCOMPARE(tree.rowCount(assets), 1);
+        QCOMPARE(tree.account_directory().name(7), u"Assets:Savings"_s);
+    }
+
+    void children_fetched_on_demand()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.prepare(u"INSERT INTO accounts(name, kind) VALUES"
+                               " ('Assets:Bank:Checking', ?), ('Assets:Bank:Savings', ?), ('Assets:Bank-2', ?)"_s));
+        for(int i = 0; i < 3; ++i) {
+            query.addBindValue(static_cast<int>(ACCOUNT_KIND_BANK));
+        }
+        QVERIFY(query.exec());
+        tree.load();
+        QTRY_COMPARE(tree.rowCount(), 5);
+
+        auto assets = tree.index(0, 0);
+        QVERIFY(tree.hasChildren(assets));
+        QCOMPARE(tree.rowCount(assets), 0);
+        QVERIFY(tree.canFetchMore(assets));
+        tree.fetchMore(assets);
+        QTRY_COMPARE(tree.rowCount(assets), 2);
+        // "Assets:Bank-2" sorts before "Assets:Bank:Checking"
+        auto bank_2 = tree.index(0, 0, assets);
+        QCOMPARE(bank_2.data(), u"Bank-2"_s);
+        QVERIFY(!tree.hasChildren(bank_2));
+        // Not an account itself, just the parent of some
+        auto bank = tree.index(1, 0, assets);
+        QCOMPARE(bank.data(), u"Bank"_s);
+        QVERIFY(bank.data(Account_ID_Role).isNull());
+        QVERIFY(tree.hasChildren(bank));
+
+        tree.fetchMore(bank);
+        QTRY_COMPARE(tree.rowCount(bank), 2);
+        QCOMPARE(tree.index(0, 0, bank).data(Account_Path_Role), u"Assets:Bank:Checking"_s);
+        QCOMPARE(tree.index(1, 0, bank).data(), u"Savings"_s);
+        QVERIFY(!tree.canFetchMore(bank));
+    }
+
+    void account_directory()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto& directory = tree.account_directory();
+        QCOMPARE(directory.rowCount(), 5);
+        QCOMPARE(directory.name(3), u"Expenses"_s);
+        QCOMPARE(directory.row(3), 2);
+        QCOMPARE(directory.row(42), -1);
+
+        tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, tree.index(0, 0));
+        QTRY_COMPARE(directory.rowCount(), 6);
+        // Kept sorted by name
+        QCOMPARE(directory.row(6), 1);
+        QCOMPARE(directory.index(1).data(), u"Assets:Checking"_s);
+        QCOMPARE(directory.index(1).data(Account_ID_Role), 6);
+
+        tree.removeRow(0, tree.index(0, 0));
+        QTRY_COMPARE(directory.rowCount(), 5);
+        QCOMPARE(directory.name(6), u""_s);
+    }
+
+    void move_subtree()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.prepare(u"INSERT INTO accounts(name, kind) VALUES ('Assets:Investment:Bonds', ?), ('Assets:Investment:Fund', ?)"_s));
+        query.addBindValue(static_cast<int>(ACCOUNT_KIND_BANK));
+        query.addBindValue(static_cast<int>(ACCOUNT_KIND_BANK));
+        QVERIFY(query.exec());
+        tree.load();
+        QTRY_COMPARE(tree.rowCount(), 5);
+        auto assets = tree.index(0, 0);
+        tree.fetchMore(assets);
+        QTRY_COMPARE(tree.rowCount(assets), 1);
+        auto investment = tree.index(0, 0, assets);
+        tree.fetchMore(investment);
+        QTRY_COMPARE(tree.rowCount(investment), 2);
+
+        QVERIFY_THROWS_EXCEPTION(sql_helpers::Error, tree.move_account(investment, u"Assets:Investment:Bonds:Other"_s));
+        QSignalSpy directory_reset{&tree.account_directory(), &QAbstractItemModel::modelReset};
+        tree.move_account(investment, u"Assets:Holdings:Long-Term"_s);
+        // The old intermediate level is replaced by the new one once the worker has renamed the accounts
+        QTRY_COMPARE(tree.index(0, 0, assets).data(), u"Holdings"_s);
+        QCOMPARE(tree.rowCount(assets), 1);
+        auto holdings = tree.index(0, 0, assets);
+        auto long_term = tree.index(0, 0, holdings);
+        QCOMPARE(long_term.data(Account_Path_Role), u"Assets:Holdings:Long-Term"_s);
+        QCOMPARE(tree.index(1, 0, long_term).data(Account_Path_Role), u"Assets:Holdings:Long-Term:Fund"_s);
+        QCOMPARE(tree.account_directory().name(6), u"Assets:Holdings:Long-Term:Bonds"_s);
+        // The renamed entries are updated in place, so the directory's views keep their state
+        QCOMPARE(directory_reset.count(), 0);
+        QCOMPARE(tree.account_directory().row(6), 1);
+
+        QVERIFY(query.exec(u"SELECT name FROM accounts WHERE id = 7"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0), u"Assets:Holdings:Long-Term:Fund"_s);
+
+        // Only placeholders can have subaccounts
+        QSignalSpy error_spy{&tree, &AccountTree::error_occurred};
+        auto bonds = tree.index(0, 0, long_term);
+        tree.move_account(bonds, u"Assets:Holdings:Long-Term:Fund:Bonds"_s);
+        QTRY_COMPARE(error_spy.count(), 1);
+        QCOMPARE(bonds.data(Account_Path_Role), u"Assets:Holdings:Long-Term:Bonds"_s);
+        QCOMPARE(tree.account_directory().name(6), u"Assets:Holdings:Long-Term:Bonds"_s);
+
+        // Characters outside the BMP are two UTF-16 code units but one character to SQLite
+        tree.move_account(long_term, u"Assets:Holdings:\U0001F4C8"_s);
+        QTRY_COMPARE(tree.account_directory().name(6), u"Assets:Holdings:\U0001F4C8:Bonds"_s);
+        tree.move_account(tree.index(0, 0, holdings), u"Assets:Holdings:Shares"_s);
+        QTRY_COMPARE(tree.account_directory().name(6), u"Assets:Holdings:Shares:Bonds"_s);
+    }
+
+    void rolled_up_balances()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO accounts(name, kind) VALUES"
+                            " ('Expenses:Food', unicode('E')), ('Expenses:Home:Rent', unicode('E')), ('Assets:Checking', unicode('B'))"_s));
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'Groceries', 8, 6, 1000)"_s));
+        tree.load();
+        auto expenses_balance = tree.index(2, AccountTree::Balance_Column);
+        QTRY_COMPARE(expenses_balance.data(), u"10.00"_s);
+
+        auto expenses = tree.index(2, 0);
+        tree.fetchMore(expenses);
+        QTRY_COMPARE(tree.rowCount(expenses), 2);
+        auto home_balance = tree.index(1, AccountTree::Balance_Column, expenses);
+        QCOMPARE(home_balance.data(), u"0.00"_s);
+
+        // Changes are applied to each level above the account
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-02', 'Rent', 8, 7, 50000)"_s));
+        QTRY_COMPARE(home_balance.data(), u"500.00"_s);
+        QTRY_COMPARE(expenses_balance.data(), u"510.00"_s);
+        QCOMPARE(tree.index(0, AccountTree::Balance_Column).data(), u"-510.00"_s);
+
+        QVERIFY(query.exec(u"DELETE FROM transactions WHERE description = 'Groceries'"_s));
+        QTRY_COMPARE(expenses_balance.data(), u"500.00"_s);
+        QCOMPARE(tree.index(0, AccountTree::Balance_Column, expenses).data(), u"0.00"_s);
+    }
+
+    void subtree_transactions()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO accounts(name, kind) VALUES"
+                            " ('Expenses:Food', unicode('E')), ('Expenses:Home:Rent', unicode('E')), ('Assets:Checking', unicode('B'))"_s));
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'Groceries', 8, 6, 1000), ('2025-01-02', 'Rent', 8, 7, 50000),"
+                            " ('2025-01-03', 'Refund', 6, 8, 250), ('2025-01-04', 'Recategorized', 6, 7, 200)"_s));
+        tree.load();
+        QTRY_COMPARE(tree.account_directory().rowCount(), 8);
+
+        auto expenses = tree.index(2, 0);
+        QCOMPARE(expenses.data(), u"Expenses"_s);
+        auto transactions = tree.subtree_transactions(expenses);
+        QCOMPARE(transactions->balance(), qint64{50750});
+        transactions->fetchMore({});
+        QCOMPARE(transactions->rowCount(), 4);
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_SOURCE).data(), u"Assets:Checking"_s);
+        QCOMPARE(transactions->index(2, SubtreeTransactions::Amount_Column).data(), u"-2.50"_s);
+        // Moving money between accounts in the subtree doesn't change its balance
+        QCOMPARE(transactions->index(3, SubtreeTransactions::Amount_Column).data(), u"0.00"_s);
+        QCOMPARE(transactions->index(3, SubtreeTransactions::Balance_Column).data(), u"507.50"_s);
+
+        // Levels that aren't accounts themselves work the same way
+        tree.fetchMore(expenses);
+        QTRY_COMPARE(tree.rowCount(expenses), 2);
+        auto home = tree.subtree_transactions(tree.index(1, 0, expenses));
+        QCOMPARE(home->balance(), qint64{50200});
+
+        // Changes made elsewhere are moved into place without rereading the fetched rows
+        QSignalSpy reset{transactions.get(), &QAbstractItemModel::modelReset};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-02', 'Lunch', 8, 6, 500)"_s));
+        QTRY_COMPARE(transactions->rowCount(), 5);
+        QTRY_COMPARE(transactions->balance(), qint64{51250});
+        QCOMPARE(transactions->index(2, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Lunch"_s);
+        QCOMPARE(transactions->index(2, SubtreeTransactions::Balance_Column).data(), u"515.00"_s);
+        QCOMPARE(transactions->index(4, SubtreeTransactions::Balance_Column).data(), u"512.50"_s);
+        QVERIFY(query.exec(u"DELETE FROM transactions WHERE description = 'Rent'"_s));
+        QTRY_COMPARE(transactions->rowCount(), 4);
+        QCOMPARE(transactions->index(3, SubtreeTransactions::Balance_Column).data(), u"12.50"_s);
+        QCOMPARE(reset.count(), 0);
+
+        // The subtree follows its top level when that is moved
+        tree.move_account(tree.index(1, 0, expenses), u"Expenses:House"_s);
+        QTRY_COMPARE(home->path(), u"Expenses:House"_s);
+        QTRY_COMPARE(home->rowCount(), 1);
+        QCOMPARE(home->index(0, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Recategorized"_s);
+        QCOMPARE(home->balance(), qint64{200});
+    }
+
+    void large_subtree_transactions()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        // Enough accounts that the subtree is read in date order instead of account by account
+        auto& db = db_manager.database();
+        auto checking_id = find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK);
+        std::vector<int> bill_ids;
+        QSqlQuery query{db};
+        QVERIFY(query.prepare(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                               " VALUES (?, ?, ?, ?, ?)"_s));
+        for(int i = 0; i < 40; ++i) {
+            bill_ids.push_back(find_or_create_account(db, u"Expenses:Bills:%1"_s.arg(i, 2, 10, QChar(u'0')), ACCOUNT_KIND_EXPENSE));
+            // Later accounts have earlier transactions
+            query.addBindValue(QDate(2025, 1, 1).addDays(39 - i).toString(Qt::ISODate));
+            query.addBindValue(u"Bill %1"_s.arg(i));
+            query.addBindValue(checking_id);
+            query.addBindValue(bill_ids.back());
+            query.addBindValue(100);
+            QVERIFY(query.exec());
+        }
+        query.addBindValue(u"2025-03-01"_s);
+        query.addBindValue(u"Transfer"_s);
+        query.addBindValue(bill_ids[0]);
+        query.addBindValue(bill_ids[1]);
+        query.addBindValue(500);
+        QVERIFY(query.exec());
+        tree.load();
+        QTRY_COMPARE(tree.account_directory().rowCount(), 46);
+
+        auto transactions = tree.subtree_transactions(tree.index(2, 0));
+        transactions->fetchMore({});
+        QCOMPARE(transactions->rowCount(), 41);
+        QVERIFY(!transactions->canFetchMore({}));
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Bill 39"_s);
+        QCOMPARE(transactions->index(39, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Bill 0"_s);
+        QCOMPARE(transactions->index(39, SubtreeTransactions::Balance_Column).data(), u"40.00"_s);
+        QCOMPARE(transactions->index(40, SubtreeTransactions::Amount_Column).data(), u"0.00"_s);
+        QCOMPARE(transactions->index(40, SubtreeTransactions::Balance_Column).data(), u"40.00"_s);
+    }
+
+    void account_balances()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto assets = tree.index(0, 0);
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, assets);
+        auto savings = tree.appendRow(AccountFields{u"Savings"_s, u""_s, ACCOUNT_KIND_BANK}, assets);
+        QTRY_COMPARE(savings.data(Account_ID_Role), 7);
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'Deposit', 7, 6, 10000), ('2025-01-02', 'Transfer', 6, 7, 1050)"_s));
+        tree.load_balances();
+        QTRY_COMPARE(checking.data(Account_Balance_Role), qint64{8950});
+        QCOMPARE(savings.data(Account_Balance_Role), qint64{-8950});
+        QCOMPARE(checking.data(Qt::ToolTipRole), u"Balance: 89.50"_s);
+
+        auto transactions = tree.account_transactions(checking);
+        QCOMPARE(transactions->rowCount(), 2);
+        auto balance_column = transactions->columnCount() - 1;
+        QCOMPARE(transactions->index(0, balance_column).data(), u"100.00"_s);
+        QCOMPARE(transactions->index(1, balance_column).data(), u"89.50"_s);
+
+        // Submitted on the database worker thread
+        transactions->insertRow(transactions->rowCount());
+        auto new_row = transactions->rowCount() - 1;
+        transactions->setData(transactions->index(new_row, TRANSACTIONS_VIEW_DATE), QDate(2025, 1, 3));
+        transactions->setData(transactions->index(new_row, TRANSACTIONS_VIEW_DESCRIPTION), u"Groceries"_s);
+        transactions->setData(transactions->index(new_row, TRANSACTIONS_VIEW_SOURCE), 6);
+        transactions->setData(transactions->index(new_row, TRANSACTIONS_VIEW_DESTINATION), 3);
+        transactions->setData(transactions->index(new_row, TRANSACTIONS_AS_CASH_VIEW_AMOUNT), 25.0);
+        QSignalSpy submitted{transactions.get(), &AccountTransactions::submitted};
+        transactions->submit_all();
+        QVERIFY(submitted.wait());
+        QCOMPARE(transactions->rowCount(), 3);
+        QCOMPARE(transactions->index(2, balance_column).data(), u"64.50"_s);
+        tree.load_balances();
+        QTRY_COMPARE(checking.data(Account_Balance_Role), qint64{6450});
+    }
+
+    void submit_updates_rows_in_place()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, tree.index(0, 0));
+        QTRY_COMPARE(checking.data(Account_ID_Role), 6);
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'A', 3, 6, 1000), ('2025-01-02', 'B', 3, 6, 2000),"
+                            " ('2025-01-03', 'C', 6, 3, 500)"_s));
+
+        auto transactions = tree.account_transactions(checking);
+        QCOMPARE(transactions->rowCount(), 3);
+        auto balance_column = transactions->columnCount() - 1;
+        // A moves after C, and B is deleted
+        transactions->setData(transactions->index(0, TRANSACTIONS_VIEW_DATE), QDate(2025, 1, 4));
+        transactions->removeRow(1);
+        QSignalSpy reset{transactions.get(), &QAbstractItemModel::modelReset};
+        QSignalSpy moved{transactions.get(), &QAbstractItemModel::rowsMoved};
+        QSignalSpy submitted{transactions.get(), &AccountTransactions::submitted};
+        transactions->submit_all();
+        QVERIFY(submitted.wait());
+        QCOMPARE(reset.count(), 0);
+        QCOMPARE(moved.count(), 1);
+        QCOMPARE(transactions->rowCount(), 2);
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"C"_s);
+        QCOMPARE(transactions->index(0, balance_column).data(), u"-5.00"_s);
+        QCOMPARE(transactions->index(1, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"A"_s);
+        QCOMPARE(transactions->index(1, balance_column).data(), u"5.00"_s);
+    }
+
+    void pending_delete_follows_row()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, tree.index(0, 0));
+        QTRY_COMPARE(checking.data(Account_ID_Role), 6);
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'A', 3, 6, 1000), ('2025-01-02', 'B', 3, 6, 2000)"_s));
+
+        auto transactions = tree.account_transactions(checking);
+        QCOMPARE(transactions->rowCount(), 2);
+        transactions->removeRow(1);
+        QVERIFY(transactions->index(1, 0).data(Pending_Delete_Role).toBool());
+        // Another view's insert lands before B, which stays marked at its new row
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2024-12-31', 'Z', 3, 6, 500)"_s));
+        QTRY_COMPARE(transactions->rowCount(), 3);
+        QCOMPARE(transactions->index(2, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"B"_s);
+        QVERIFY(transactions->index(2, 0).data(Pending_Delete_Role).toBool());
+        QVERIFY(!transactions->index(1, 0).data(Pending_Delete_Role).toBool());
+
+        transactions->revert_all();
+        QVERIFY(!transactions->index(2, 0).data(Pending_Delete_Role).toBool());
+    }
+
+    void postings_follow_transactions()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto assets = tree.index(0, 0);
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, assets);
+        auto savings = tree.appendRow(AccountFields{u"Savings"_s, u""_s, ACCOUNT_KIND_BANK}, assets);
+        QTRY_COMPARE(savings.data(Account_ID_Role), 7);
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'Paycheck', 3, 6, 10000), ('2025-01-02', 'Transfer', 6, 7, 2500)"_s));
+        // Swapping the legs of a transaction and moving it to another account
+        QVERIFY(query.exec(u"UPDATE transactions SET source = destination, destination = source"
+                            " WHERE description = 'Transfer'"_s));
+        QVERIFY(query.exec(u"UPDATE transactions_as_cash_view SET destination = 7, date = '2025-01-03'"
+                            " WHERE description = 'Paycheck'"_s));
+        QVERIFY(query.exec(u"UPDATE cash_transactions SET amount = 12000"
+                            " WHERE transaction_id = (SELECT id FROM transactions WHERE description = 'Paycheck')"_s));
+        tree.load_balances();
+        QTRY_COMPARE(checking.data(Account_Balance_Role), qint64{2500});
+        QCOMPARE(savings.data(Account_Balance_Role), qint64{9500});
+
+        auto transactions = tree.account_transactions(savings);
+        QCOMPARE(transactions->rowCount(), 2);
+        auto balance_column = transactions->columnCount() - 1;
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Transfer"_s);
+        QCOMPARE(transactions->index(0, balance_column).data(), u"-25.00"_s);
+        QCOMPARE(transactions->index(1, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Paycheck"_s);
+        QCOMPARE(transactions->index(1, balance_column).data(), u"95.00"_s);
+        QCOMPARE(tree.account_transactions(checking)->rowCount(), 1);
+    }
+
+    void date_range()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, tree.index(0, 0));
+        QTRY_COMPARE(checking.data(Account_ID_Role), 6);
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'A', 3, 6, 100), ('2025-01-02', 'B', 3, 6, 200),"
+                            " ('2025-01-03', 'C', 3, 6, 400)"_s));
+        QVERIFY(query.exec(u"SELECT DISTINCT typeof(date) FROM transactions"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0), u"integer"_s);
+
+        auto transactions = tree.account_transactions(checking);
+        auto balance_column = transactions->columnCount() - 1;
+        QVERIFY(transactions->set_date_range(QDate(2025, 1, 2), QDate(2025, 1, 2)));
+        QCOMPARE(transactions->rowCount(), 1);
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_DATE).data(), QDate(2025, 1, 2));
+        // Carried forward from the rows before the range
+        QCOMPARE(transactions->index(0, balance_column).data(), u"3.00"_s);
+
+        QVERIFY(transactions->set_date_range(QDate(2025, 1, 2), {}));
+        QCOMPARE(transactions->rowCount(), 2);
+        QCOMPARE(transactions->index(1, balance_column).data(), u"7.00"_s);
+    }
+
+    void stock_account_shows_security_transactions()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO securities(symbol) VALUES ('ABC')"_s));
+        auto stock = tree.appendRow(AccountFields{u"ABC"_s, u"ABC"_s, ACCOUNT_KIND_STOCK}, tree.index(0, 0));
+        QTRY_COMPARE(stock.data(Account_ID_Role), 6);
+        QVERIFY(query.exec(u"INSERT INTO security_transactions_view(date, description, source, destination, unit_price, quantity)"
+                            " VALUES ('2025-01-01', 'Buy', 3, 6, 1500000, 20000)"_s));
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-02', 'Fee', 6, 3, 500)"_s));
+
+        auto transactions = tree.account_transactions(stock);
+        QCOMPARE(transactions->rowCount(), 1);
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Buy"_s);
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_COL_COUNT).data(), u"150.0000"_s);
+        QCOMPARE(transactions->index(0, TRANSACTIONS_VIEW_COL_COUNT + 1).data(), u"2.0000"_s);
+        QCOMPARE(transactions->index(0, transactions->columnCount() - 1).data(), u"300.00"_s);
+    }
+
+    void changes_reach_other_views()
+    {
+        AccountTree tree{db_manager};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_VERIFY(tree.rowCount() > 0);
+
+        auto checking = tree.appendRow(AccountFields{u"Checking"_s, u""_s, ACCOUNT_KIND_BANK}, tree.index(0, 0));
+        QTRY_COMPARE(checking.data(Account_ID_Role), 6);
+        QSignalSpy rows_changed{&db_manager, &DatabaseManager::rows_changed};
+        QSqlQuery query{db_manager.database()};
+        QVERIFY(query.exec(u"INSERT INTO transactions_as_cash_view(date, description, source, destination, amount)"
+                            " VALUES ('2025-01-01', 'Paycheck', 3, 6, 1000)"_s));
+        QVERIFY(rows_changed.wait());
+        auto changes = rows_changed.takeFirst().at(0).value<DatabaseChanges>();
+        QVERIFY(changes.at(u"transactions"_s).inserted.contains(1));
+        QVERIFY(changes.at(u"account_balances"_s).updated.contains(6));
+        // No load_balances() needed
+        QTRY_COMPARE(checking.data(Account_Balance_Role), qint64{1000});
+
+        auto first_view = tree.account_transactions(checking);
+        auto second_view = tree.account_transactions(checking);
+        QCOMPARE(second_view->rowCount(), 1);
+        first_view->insertRow(first_view->rowCount());
+        auto new_row = first_view->rowCount() - 1;
+        first_view->setData(first_view->index(new_row, TRANSACTIONS_VIEW_DATE), QDate(2024, 12, 31));
+        first_view->setData(first_view->index(new_row, TRANSACTIONS_VIEW_DESCRIPTION), u"Opening"_s);
+        first_view->setData(first_view->index(new_row, TRANSACTIONS_VIEW_SOURCE), 3);
+        first_view->setData(first_view->index(new_row, TRANSACTIONS_VIEW_DESTINATION), 6);
+        first_view->setData(first_view->index(new_row, TRANSACTIONS_AS_CASH_VIEW_AMOUNT), 5.0);
+        QSignalSpy reset{second_view.get(), &QAbstractItemModel::modelReset};
+        first_view->submit_all();
+        QTRY_COMPARE(second_view->rowCount(), 2);
+        QCOMPARE(reset.count(), 0);
+        auto balance_column = second_view->columnCount() - 1;
+        QCOMPARE(second_view->index(0, TRANSACTIONS_VIEW_DESCRIPTION).data(), u"Opening"_s);
+        QCOMPARE(second_view->index(1, balance_column).data(), u"15.00"_s);
+        QTRY_COMPARE(checking.data(Account_Balance_Role), qint64{1500});
+    }
+
+    void read_while_worker_writes()
+    {
+        QSignalSpy loaded{&db_manager, &DatabaseManager::database_loaded};
+        db_manager.load_database(u":memory:"_s);
+        QVERIFY(loaded.wait());
+
+        // The worker thread stays in the middle of a write transaction until released
+        QSemaphore written, released;
+        auto write = db_manager.run_async([&](QSqlDatabase& db) {
+            sql_helpers::Transaction transaction{db};
+            QSqlQuery query{db};
+            sql_helpers::exec(query, u"INSERT INTO accounts(name, kind) VALUES ('Assets:Checking', unicode('B'))"_s);
+            written.release();
+            released.acquire();
+            transaction.commit();
+        });
+        written.acquire();
+        QSqlQuery query{db_manager.database()};
+        QVERIFY2(query.exec(u"SELECT count(*) FROM accounts"_s), qPrintable(query.lastError().text()));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 5);
+        query.finish();
+        released.release();
+        write.waitForFinished();
+
+        QVERIFY(query.exec(u"SELECT count(*) FROM accounts"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 6);
+    }
 };
 
 QTEST_MAIN(AccountTreeTests)
@@ -0,0 +1,281 @@
+#include <stdexcept>
+#include <QDate>
+#include <QFile>
+#include <QSignalSpy>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTest>
+#include "DatabaseManager.hpp"
+#include "SQLColumns.hpp"
+#include "import/Categoriser.hpp"
+#include "import/CsvImporter.hpp"
+#include "import/LedgerWriter.hpp"
+#ifdef WITH_OFX
+#include "import/OfxImporter.hpp"
+#endif
+#include "util/sql_helpers.hpp"
+
+using namespace Qt::StringLiterals;
+
+class ImportTests : public QObject {
+    Q_OBJECT
+
+    DatabaseManager db_manager;
+
+    int account_id(const QString& path)
+    {
+        auto& query = sql_helpers::prepared(db_manager.database(), u"SELECT id FROM accounts WHERE name = ?"_s);
+        query.addBindValue(path);
+        sql_helpers::exec(query);
+        sql_helpers::next(query);
+        auto id = query.value(0).toInt();
+        query.finish();
+        return id;
+    }
+private slots:
+    void initTestCase()
+    {
+        connect(&db_manager, &DatabaseManager::failed_to_load_database, [](QString err_message) {
+            QFAIL(err_message.toStdString().c_str());
+        });
+    }
+
+    // Each test imports into a new database
+    void init()
+    {
+        QSignalSpy loaded{&db_manager, &DatabaseManager::database_loaded};
+        db_manager.load_database(u":memory:"_s);
+        QTRY_COMPARE(loaded.count(), 1);
+    }
+
+    void ledger_writer()
+    {
+        auto& db = db_manager.database();
+        auto checking_id = find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK);
+        QCOMPARE(checking_id, account_id(u"Assets:Checking"_s));
+        QCOMPARE(find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK), checking_id);
+        auto income_id = account_id(u"Income"_s);
+        auto expenses_id = account_id(u"Expenses"_s);
+        LedgerWriter writer{db, 2};
+        auto day = QDate(2025, 1, 1).toJulianDay();
+        writer.add(ImportedTransaction{day, u"A"_s, income_id, checking_id, 100});
+        QCOMPARE(writer.written_count(), 0);
+        writer.add(ImportedTransaction{day + 1, u"B"_s, income_id, checking_id, 200});
+        QCOMPARE(writer.written_count(), 2);
+        writer.add(ImportedTransaction{day + 2, u"C"_s, checking_id, expenses_id, 50, checking_id, u"FITID3"_s});
+        writer.flush();
+        QCOMPARE(writer.written_count(), 3);
+
+        QSqlQuery query{db};
+        QVERIFY(query.exec(u"SELECT count(*), max(date) FROM transactions_as_cash_view WHERE description = 'C'"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+        QCOMPARE(query.value(1), u"2025-01-03"_s);
+        QVERIFY(query.exec(u"SELECT balance FROM account_balances WHERE account_id = %1"_s.arg(checking_id)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), 250);
+        QVERIFY(query.exec(u"SELECT t.description FROM imported_transactions i"
+                            " JOIN transactions t ON t.id = i.transaction_id"
+                            " WHERE i.account_id = %1 AND i.import_key = 'FITID3'"_s.arg(checking_id)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0), u"C"_s);
+    }
+
+    void duplicate_import_keys()
+    {
+        auto& db = db_manager.database();
+        auto checking_id = find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK);
+        auto income_id = account_id(u"Income"_s);
+        auto day = QDate(2025, 1, 1).toJulianDay();
+        {
+            // Twice in one batch
+            LedgerWriter writer{db};
+            writer.add(ImportedTransaction{day, u"A"_s, income_id, checking_id, 100, checking_id, u"K1"_s});
+            writer.add(ImportedTransaction{day, u"A"_s, income_id, checking_id, 100, checking_id, u"K1"_s});
+            writer.flush();
+            QCOMPARE(writer.written_count(), 1);
+            QCOMPARE(writer.duplicate_count(), 1);
+        }
+        // Imported again later, e.g. by another connection. The same key in another account is
+        // a different transaction
+        auto savings_id = find_or_create_account(db, u"Assets:Savings"_s, ACCOUNT_KIND_BANK);
+        LedgerWriter writer{db, 1};
+        writer.add(ImportedTransaction{day, u"A"_s, income_id, checking_id, 100, checking_id, u"K1"_s});
+        writer.add(ImportedTransaction{day, u"B"_s, income_id, savings_id, 200, savings_id, u"K1"_s});
+        writer.flush();
+        QCOMPARE(writer.written_count(), 1);
+        QCOMPARE(writer.duplicate_count(), 1);
+
+        QSqlQuery query{db};
+        QVERIFY(query.exec(u"SELECT count(*) FROM transactions"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2);
+        QVERIFY(query.exec(u"SELECT balance FROM account_balances WHERE account_id = %1"_s.arg(checking_id)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), 100);
+    }
+
+    void csv_import()
+    {
+        auto& db = db_manager.database();
+        auto checking_id = find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK);
+        QTemporaryDir dir;
+        QFile file{dir.filePath(u"statement.csv"_s)};
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("Amount;Date;Description\r\n"
+                   "\"1.000,50\";31/12/2024;Paycheck\r\n"
+                   "\r\n"
+                   "(2,25);1/1/2025;\"Coffee; \"\"large\"\"\"\r\n");
+        file.close();
+        CsvImporter importer{db, CsvFormat{.date_column = 1, .description_column = 2, .amount_column = 0,
+                                           .delimiter = ';', .decimal_separator = ',',
+                                           .date_order = DateOrder::DayMonthYear}};
+        QCOMPARE(importer.import_file(file.fileName(), checking_id), 2);
+
+        QSqlQuery query{db};
+        QVERIFY(query.exec(u"SELECT date, description, source, destination, amount FROM transactions_as_cash_view ORDER BY id"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0), u"2024-12-31"_s);
+        QCOMPARE(query.value(4).toLongLong(), 100050);
+        QCOMPARE(query.value(3).toInt(), checking_id);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(1), u"Coffee; \"large\""_s);
+        QCOMPARE(query.value(2).toInt(), checking_id);
+        QCOMPARE(query.value(4).toLongLong(), 225);
+
+        // A bad row stops the whole file from being imported
+        QVERIFY(file.open(QIODevice::Append));
+        file.write("12,34;2025-13-01;Bad date\n");
+        file.close();
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error, importer.import_file(file.fileName(), checking_id));
+        QVERIFY(query.exec(u"SELECT count(*) FROM transactions"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2);
+
+        // Amounts too large to count in cents are rejected instead of wrapping around
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write("Amount;Date;Description\n92233720368547758,08;1/1/2025;Too large\n");
+        file.close();
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error, importer.import_file(file.fileName(), checking_id));
+        QVERIFY(query.exec(u"SELECT count(*) FROM transactions"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 2);
+    }
+
+    void categorisation_rules()
+    {
+        RuleMatcher matcher{{{u"coffee"_s, 10}, {u"STAR"_s, 11}, {u"starbucks"_s, 12}, {u"bucks"_s, 13}}};
+        QCOMPARE(matcher.match(u"Starbucks #123"), 12);
+        QCOMPARE(matcher.match(u"Joe's Coffee"), 10);
+        QCOMPARE(matcher.match(u"the rising star"), 11);
+        QCOMPARE(matcher.match(u"Grocery"), 0);
+
+        auto& db = db_manager.database();
+        auto checking_id = find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK);
+        auto groceries_id = find_or_create_account(db, u"Expenses:Groceries"_s, ACCOUNT_KIND_EXPENSE);
+        auto day = QDate(2025, 1, 1).toJulianDay();
+        {
+            // Imported before there were any rules
+            Categoriser categoriser{db};
+            LedgerWriter writer{db};
+            writer.add(categoriser.categorise(day, u"GROCER #1"_s, checking_id, -500));
+            writer.add(categoriser.categorise(day, u"Paycheck"_s, checking_id, 10000));
+            writer.flush();
+        }
+        QSqlQuery query{db};
+        QVERIFY(query.exec(u"INSERT INTO categorisation_rules(pattern, account_id) VALUES ('grocer', %1)"_s.arg(groceries_id)));
+        QCOMPARE(Categoriser{db}.categorise(day, u"Grocer #2"_s, checking_id, -100).destination, groceries_id);
+
+        QCOMPARE(recategorise_transactions(db), 1);
+        QVERIFY(query.exec(u"SELECT a.name FROM transactions t JOIN accounts a ON a.id = t.destination ORDER BY t.id"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0), u"Expenses:Groceries"_s);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0), u"Assets:Checking"_s);
+        QVERIFY(query.exec(u"SELECT balance FROM account_balances WHERE account_id = %1"_s.arg(groceries_id)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), 500);
+    }
+
+    void transfer_matching()
+    {
+        auto& db = db_manager.database();
+        auto checking_id = find_or_create_account(db, u"Assets:Checking"_s, ACCOUNT_KIND_BANK);
+        auto savings_id = find_or_create_account(db, u"Assets:Savings"_s, ACCOUNT_KIND_BANK);
+        Categoriser categoriser{db};
+        auto day = QDate(2025, 1, 1).toJulianDay();
+        {
+            // Imported from the savings statement earlier
+            LedgerWriter writer{db};
+            writer.add(categoriser.categorise(day + 10, u"Transfer in"_s, savings_id, 300));
+            writer.flush();
+        }
+        LedgerWriter writer{db};
+        writer.match_transfers(categoriser.transfer_matching());
+        writer.add(categoriser.categorise(day, u"Transfer out"_s, checking_id, -500));
+        writer.add(categoriser.categorise(day + 2, u"Transfer in"_s, savings_id, 500));
+        auto with_key = categoriser.categorise(day + 11, u"Transfer out"_s, checking_id, -300);
+        with_key.import_account = checking_id;
+        with_key.import_key = u"K"_s;
+        writer.add(std::move(with_key));
+        // Outside the window of the transfer in
+        writer.add(categoriser.categorise(day + 20, u"Rent"_s, checking_id, -500));
+        writer.flush();
+        QCOMPARE(writer.written_count(), 4);
+        QCOMPARE(writer.transfer_count(), 2);
+
+        QSqlQuery query{db};
+        QVERIFY(query.exec(u"SELECT id, source, destination, amount FROM transactions_as_cash_view ORDER BY id"_s));
+        QVERIFY(query.next());
+        auto existing_id = query.value(0).toLongLong();
+        QCOMPARE(query.value(1).toInt(), checking_id);
+        QCOMPARE(query.value(2).toInt(), savings_id);
+        QCOMPARE(query.value(3).toLongLong(), 300);
+        QVERIFY(query.next());
+        QCOMPARE(query.value(1).toInt(), checking_id);
+        QCOMPARE(query.value(2).toInt(), savings_id);
+        QCOMPARE(query.value(3).toLongLong(), 500);
+        QVERIFY(query.next());
+        QVERIFY(query.value(2).toInt() != savings_id);
+        QVERIFY(!query.next());
+        QVERIFY(query.exec(u"SELECT transaction_id FROM imported_transactions WHERE import_key = 'K'"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), existing_id);
+        QVERIFY(query.exec(u"SELECT balance FROM account_balances WHERE account_id = %1"_s.arg(savings_id)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), 800);
+    }
+
+#ifdef WITH_OFX
+    void ofx_import()
+    {
+        auto& db = db_manager.database();
+        OfxImporter importer{db};
+        QSignalSpy progress{&importer, &OfxImporter::progress};
+        // The two coffees have no FITID and the same contents, but are still told apart
+        QCOMPARE(importer.import_file(QString::fromUtf8(OFX_FIXTURE_DIR "/statement.ofx")), 3);
+        QCOMPARE(progress.count(), 1);
+
+        QSqlQuery query{db};
+        QVERIFY(query.exec(u"SELECT b.balance FROM ofx_accounts o JOIN account_balances b ON b.account_id = o.account_id"
+                            " WHERE o.ofx_account_id LIKE '%1000001%'"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toLongLong(), 149150);
+        QVERIFY(query.exec(u"SELECT count(*) FROM imported_transactions WHERE import_key = '20250103-1'"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 1);
+
+        // Importing the same statement again adds nothing
+        auto result = importer.import_directory(QString::fromUtf8(OFX_FIXTURE_DIR));
+        QCOMPARE(result.imported_count, 0);
+        QCOMPARE(result.duplicate_count, 3);
+        QVERIFY(result.failed_files.isEmpty());
+        QVERIFY(query.exec(u"SELECT count(*) FROM transactions"_s));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 3);
+    }
+#endif
+};
+
+QTEST_MAIN(ImportTests)
+#include "ImportTests.moc"